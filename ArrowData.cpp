@@ -0,0 +1,346 @@
+#include "ArrowData.hpp"
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+// Storage behind an exported schema, freed by its release callback
+struct SchemaData {
+    std::string format;
+    std::string name;
+    std::vector<ArrowSchema> children;
+    std::vector<ArrowSchema *> childPointers;
+    std::unique_ptr<ArrowSchema> dictionary;
+};
+
+// Storage behind an exported array: the buffer list and any buffers that had
+// to be built because the column layout differs from Arrow's
+struct ArrayData {
+    std::vector<const void *> buffers;
+    std::vector<ArrowArray> children;
+    std::vector<ArrowArray *> childPointers;
+    std::unique_ptr<ArrowArray> dictionary;
+    std::vector<uint8_t> bits;
+    std::vector<int32_t> offsets;
+    std::vector<int64_t> largeOffsets;
+    std::string bytes;
+};
+
+// Children may have been moved out by the consumer, those are already released
+static void releaseSchema(ArrowSchema *schema) {
+    for (int64_t i = 0; i < schema->n_children; ++i) {
+        if (schema->children[i]->release) {
+            schema->children[i]->release(schema->children[i]);
+        }
+    }
+    if (schema->dictionary && schema->dictionary->release) {
+        schema->dictionary->release(schema->dictionary);
+    }
+    delete static_cast<SchemaData *>(schema->private_data);
+    schema->release = nullptr;
+}
+
+static void releaseArray(ArrowArray *array) {
+    for (int64_t i = 0; i < array->n_children; ++i) {
+        if (array->children[i]->release) {
+            array->children[i]->release(array->children[i]);
+        }
+    }
+    if (array->dictionary && array->dictionary->release) {
+        array->dictionary->release(array->dictionary);
+    }
+    delete static_cast<ArrayData *>(array->private_data);
+    array->release = nullptr;
+}
+
+static SchemaData *makeSchema(ArrowSchema *schema, const std::string &format, const std::string &name, size_t children) {
+    SchemaData *data = new SchemaData{format, name, std::vector<ArrowSchema>(children), {}, nullptr};
+    for (auto &child : data->children) {
+        data->childPointers.push_back(&child);
+    }
+    *schema = ArrowSchema{data->format.c_str(), data->name.c_str(), nullptr, ARROW_FLAG_NULLABLE,
+        static_cast<int64_t>(children), data->childPointers.data(), nullptr, releaseSchema, data};
+    return data;
+}
+
+static ArrayData *makeArray(ArrowArray *array, int64_t length, int64_t nullCount, size_t buffers, size_t children) {
+    ArrayData *data = new ArrayData{std::vector<const void *>(buffers, nullptr), std::vector<ArrowArray>(children),
+        {}, nullptr, {}, {}, {}, {}};
+    for (auto &child : data->children) {
+        data->childPointers.push_back(&child);
+    }
+    *array = ArrowArray{length, nullCount, 0, static_cast<int64_t>(buffers), static_cast<int64_t>(children),
+        data->buffers.data(), data->childPointers.data(), nullptr, releaseArray, data};
+    return data;
+}
+
+// Offsets and data of a string array, with 64-bit offsets once the data
+// outgrows 32-bit ones. Returns the Arrow format of the layout used.
+static std::string exportStrings(const std::vector<std::string_view> &values, ArrayData *data) {
+    size_t bytes = 0;
+    for (std::string_view value : values) {
+        bytes += value.size();
+    }
+    data->bytes.reserve(bytes);
+    bool large = bytes > INT32_MAX;
+    if (large) {
+        data->largeOffsets.reserve(values.size() + 1);
+        data->largeOffsets.push_back(0);
+    }
+    else {
+        data->offsets.reserve(values.size() + 1);
+        data->offsets.push_back(0);
+    }
+    for (std::string_view value : values) {
+        data->bytes.append(value.data(), value.size());
+        if (large) {
+            data->largeOffsets.push_back(static_cast<int64_t>(data->bytes.size()));
+        }
+        else {
+            data->offsets.push_back(static_cast<int32_t>(data->bytes.size()));
+        }
+    }
+    data->buffers[1] = large ? static_cast<const void *>(data->largeOffsets.data()) : data->offsets.data();
+    data->buffers[2] = data->bytes.data();
+    return large ? "U" : "u";
+}
+
+static void exportColumn(const Column &column, const std::string &name, size_t rows, ArrowArray *array, ArrowSchema *schema) {
+    int64_t length = static_cast<int64_t>(rows);
+    int64_t nullCount = static_cast<int64_t>(column.nullCount());
+    const void *validity = nullCount > 0 ? column.validityData().data() : nullptr;
+    switch (column.getType()) {
+        case ColumnType::Int64:
+            makeSchema(schema, "l", name, 0);
+            makeArray(array, length, nullCount, 2, 0)->buffers[1] = column.intData().data();
+            break;
+        case ColumnType::Double:
+            makeSchema(schema, "g", name, 0);
+            makeArray(array, length, nullCount, 2, 0)->buffers[1] = column.doubleData().data();
+            break;
+        case ColumnType::Bool: {
+            makeSchema(schema, "b", name, 0);
+            ArrayData *data = makeArray(array, length, nullCount, 2, 0);
+            data->bits.assign((rows + 7) / 8, 0);
+            const std::vector<uint8_t> &values = column.boolData();
+            for (size_t row = 0; row < rows; ++row) {
+                data->bits[row / 8] |= static_cast<uint8_t>((values[row] != 0) << (row % 8));
+            }
+            data->buffers[1] = data->bits.data();
+            break;
+        }
+        case ColumnType::Categorical: {
+            // Codes are the int32 indices of a dictionary encoded array
+            SchemaData *schemaData = makeSchema(schema, "i", name, 0);
+            ArrayData *data = makeArray(array, length, nullCount, 2, 0);
+            data->buffers[1] = column.codeData().data();
+            const std::vector<std::string_view> &dictionary = column.dictionaryData();
+            data->dictionary.reset(new ArrowArray);
+            ArrayData *dictData = makeArray(data->dictionary.get(), static_cast<int64_t>(dictionary.size()), 0, 3, 0);
+            schemaData->dictionary.reset(new ArrowSchema);
+            makeSchema(schemaData->dictionary.get(), exportStrings(dictionary, dictData), "", 0);
+            schema->dictionary = schemaData->dictionary.get();
+            array->dictionary = data->dictionary.get();
+            break;
+        }
+        default: {
+            ArrayData *data = makeArray(array, length, nullCount, 3, 0);
+            makeSchema(schema, exportStrings(column.stringData(), data), name, 0);
+            break;
+        }
+    }
+    static_cast<ArrayData *>(array->private_data)->buffers[0] = validity;
+}
+
+void ArrowData::exportColumns(const std::vector<std::string> &headers, const std::vector<Column> &columns,
+    size_t rowCount, ArrowArray *array, ArrowSchema *schema) {
+    SchemaData *schemaData = makeSchema(schema, "+s", "", columns.size());
+    schema->flags = 0;
+    ArrayData *arrayData = makeArray(array, static_cast<int64_t>(rowCount), 0, 1, columns.size());
+    for (size_t col = 0; col < columns.size(); ++col) {
+        exportColumn(columns[col], headers[col], rowCount, &arrayData->children[col], &schemaData->children[col]);
+    }
+}
+
+static bool bitAt(const void *bits, int64_t i) {
+    return (static_cast<const uint8_t *>(bits)[i / 8] >> (i % 8)) & 1;
+}
+
+template<typename T>
+static T valueAt(const void *buffer, int64_t i) {
+    T value;
+    std::memcpy(&value, static_cast<const char *>(buffer) + i * sizeof(T), sizeof(T));
+    return value;
+}
+
+static bool isIntegerFormat(const std::string &format) {
+    return format.size() == 1 && std::string("cCsSiIl").find(format[0]) != std::string::npos;
+}
+
+// Reads entry i of a buffer of any signed or narrower unsigned integer format
+static int64_t integerAt(const std::string &format, const void *buffer, int64_t i) {
+    switch (format[0]) {
+        case 'c': return valueAt<int8_t>(buffer, i);
+        case 'C': return valueAt<uint8_t>(buffer, i);
+        case 's': return valueAt<int16_t>(buffer, i);
+        case 'S': return valueAt<uint16_t>(buffer, i);
+        case 'i': return valueAt<int32_t>(buffer, i);
+        case 'I': return valueAt<uint32_t>(buffer, i);
+        default: return valueAt<int64_t>(buffer, i);
+    }
+}
+
+// Entry i of a "u" or "U" string array, as a view into its data buffer
+static std::string_view stringAt(const ArrowArray *array, bool large, int64_t i) {
+    const char *data = static_cast<const char *>(array->buffers[2]);
+    int64_t begin = large ? valueAt<int64_t>(array->buffers[1], i) : valueAt<int32_t>(array->buffers[1], i);
+    int64_t end = large ? valueAt<int64_t>(array->buffers[1], i + 1) : valueAt<int32_t>(array->buffers[1], i + 1);
+    return std::string_view(data + begin, static_cast<size_t>(end - begin));
+}
+
+static bool isStringFormat(const std::string &format) {
+    return format == "u" || format == "U";
+}
+
+// Builds column from rows [offset, offset + rows) of child, nulls of the parent
+// struct array make the whole row null
+Column ArrowData::importColumn(const ArrowArray *child, const ArrowSchema *schema, const ArrowArray *parent) {
+    std::string format = schema->format ? schema->format : "";
+    int64_t rows = parent->length;
+    int64_t offset = parent->offset + child->offset;
+    bool isInteger = isIntegerFormat(format);
+    if (child->n_buffers < 2 || (rows > 0 && !child->buffers[1]) || (isStringFormat(format) && child->n_buffers < 3)) {
+        throw std::invalid_argument("unsupported Arrow array: " + std::string(schema->name ? schema->name : ""));
+    }
+    Column column;
+    if (schema->dictionary) {
+        const ArrowArray *dict = child->dictionary;
+        std::string dictFormat = schema->dictionary->format ? schema->dictionary->format : "";
+        if (!isInteger || !dict || !isStringFormat(dictFormat) || dict->n_buffers < 3) {
+            throw std::invalid_argument("unsupported Arrow format: dictionary of " + dictFormat);
+        }
+        column = Column(ColumnType::Categorical);
+        // Arrow dictionaries may repeat values or hold nulls, entries are
+        // mapped onto distinct codes with -1 for null
+        std::vector<int32_t> codeOf(static_cast<size_t>(dict->length), -1);
+        for (int64_t i = 0; i < dict->length; ++i) {
+            int64_t pos = dict->offset + i;
+            if (dict->null_count != 0 && dict->buffers[0] && !bitAt(dict->buffers[0], pos)) {
+                continue;
+            }
+            std::string_view value = stringAt(dict, dictFormat == "U", pos);
+            if (value.empty()) {
+                continue;
+            }
+            auto it = column.dictionaryIndex.find(value);
+            if (it == column.dictionaryIndex.end()) {
+                it = column.dictionaryIndex.emplace(value, static_cast<int32_t>(column.dictionary.size())).first;
+                column.dictionary.push_back(value);
+            }
+            codeOf[i] = it->second;
+        }
+        column.codes.resize(static_cast<size_t>(rows));
+        for (int64_t row = 0; row < rows; ++row) {
+            int64_t index = integerAt(format, child->buffers[1], offset + row);
+            bool valid = child->null_count == 0 || !child->buffers[0] || bitAt(child->buffers[0], offset + row);
+            if (valid && (index < 0 || index >= dict->length)) {
+                throw std::out_of_range("Arrow dictionary index out of range: " + std::to_string(index));
+            }
+            column.codes[row] = valid ? codeOf[index] : -1;
+        }
+    }
+    else if (isInteger) {
+        column = Column(ColumnType::Int64);
+        column.ints.resize(static_cast<size_t>(rows));
+        for (int64_t row = 0; row < rows; ++row) {
+            column.ints[row] = integerAt(format, child->buffers[1], offset + row);
+        }
+    }
+    else if (format == "g" || format == "f") {
+        column = Column(ColumnType::Double);
+        column.doubles.resize(static_cast<size_t>(rows));
+        if (format == "g") {
+            std::memcpy(column.doubles.data(), static_cast<const double *>(child->buffers[1]) + offset, rows * sizeof(double));
+        }
+        else {
+            for (int64_t row = 0; row < rows; ++row) {
+                column.doubles[row] = valueAt<float>(child->buffers[1], offset + row);
+            }
+        }
+    }
+    else if (format == "b") {
+        column = Column(ColumnType::Bool);
+        column.bools.resize(static_cast<size_t>(rows));
+        for (int64_t row = 0; row < rows; ++row) {
+            column.bools[row] = bitAt(child->buffers[1], offset + row);
+        }
+    }
+    else if (isStringFormat(format)) {
+        column = Column(ColumnType::String);
+        column.strings.resize(static_cast<size_t>(rows));
+        for (int64_t row = 0; row < rows; ++row) {
+            column.strings[row] = stringAt(child, format == "U", offset + row);
+        }
+    }
+    else {
+        throw std::invalid_argument("unsupported Arrow format: " + format);
+    }
+
+    for (int64_t row = 0; row < rows; ++row) {
+        bool valid = (child->null_count == 0 || !child->buffers[0] || bitAt(child->buffers[0], offset + row))
+            && (parent->null_count == 0 || !parent->buffers[0] || bitAt(parent->buffers[0], parent->offset + row));
+        if (column.type == ColumnType::Categorical) {
+            valid = valid && column.codes[row] >= 0;
+        }
+        else if (column.type == ColumnType::String) {
+            valid = valid && !column.strings[row].empty();
+        }
+        if (!valid) {
+            column.markNull(static_cast<size_t>(row));
+            switch (column.type) {
+                case ColumnType::Int64: column.ints[row] = 0; break;
+                case ColumnType::Double: column.doubles[row] = 0.; break;
+                case ColumnType::Bool: column.bools[row] = 0; break;
+                case ColumnType::Categorical: column.codes[row] = -1; break;
+                default: column.strings[row] = std::string_view(); break;
+            }
+        }
+    }
+    return column;
+}
+
+// Releases the imported schema however the import ends
+struct SchemaRelease {
+    ArrowSchema *schema;
+    ~SchemaRelease() {
+        if (schema->release) {
+            schema->release(schema);
+        }
+    }
+};
+
+void ArrowData::importColumns(ArrowArray *array, ArrowSchema *schema, std::vector<std::string> &headers,
+    std::vector<Column> &columns, size_t &rowCount) {
+    SchemaRelease schemaRelease{schema};
+    // The array is moved into a shared owner, released along with the last
+    // column still viewing its buffers
+    std::shared_ptr<ArrowArray> owner(new ArrowArray(*array), [](ArrowArray *moved) {
+        if (moved->release) {
+            moved->release(moved);
+        }
+        delete moved;
+    });
+    array->release = nullptr;
+    if (!schema->format || std::string(schema->format) != "+s" || schema->n_children != owner->n_children) {
+        throw std::invalid_argument("unsupported Arrow format: expected a struct array");
+    }
+    headers.clear();
+    columns.clear();
+    for (int64_t i = 0; i < owner->n_children; ++i) {
+        const ArrowSchema *childSchema = schema->children[i];
+        headers.push_back(childSchema->name ? childSchema->name : "");
+        columns.push_back(importColumn(owner->children[i], childSchema, owner.get()));
+        columns.back().addOwner(owner);
+    }
+    rowCount = static_cast<size_t>(owner->length);
+}
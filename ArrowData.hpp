@@ -0,0 +1,64 @@
+#ifndef ARROWDATA_HPP
+#define ARROWDATA_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Column.hpp"
+
+// Structures of the Arrow C Data Interface, a plain C ABI shared with Arrow
+// based libraries such as pyarrow and DuckDB
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+    const char *format;
+    const char *name;
+    const char *metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema **children;
+    struct ArrowSchema *dictionary;
+    void (*release)(struct ArrowSchema *);
+    void *private_data;
+};
+
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void **buffers;
+    struct ArrowArray **children;
+    struct ArrowArray *dictionary;
+    void (*release)(struct ArrowArray *);
+    void *private_data;
+};
+
+#endif  // ARROW_C_DATA_INTERFACE
+
+// Conversion between dataframe columns and a struct array of the Arrow C Data
+// Interface, one child per column.
+// Exported Int64, Double and Categorical columns hand out their value, code and
+// validity buffers without copying, so the columns must stay alive and unchanged
+// until the consumer releases the array. Bool columns are packed into bits and
+// strings into offsets plus one data block, as Arrow lays them out.
+// Imported string values stay views into the Arrow buffers, which are released
+// once no column refers to them. Numbers are widened into the column vectors.
+class ArrowData {
+private:
+    static Column importColumn(const ArrowArray *child, const ArrowSchema *schema, const ArrowArray *parent);
+
+public:
+    static void exportColumns(const std::vector<std::string> &headers, const std::vector<Column> &columns,
+        size_t rowCount, ArrowArray *array, ArrowSchema *schema);
+    static void importColumns(ArrowArray *array, ArrowSchema *schema, std::vector<std::string> &headers,
+        std::vector<Column> &columns, size_t &rowCount);
+};
+
+#endif  // ARROWDATA_HPP
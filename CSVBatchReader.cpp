@@ -0,0 +1,132 @@
+#include "CSVBatchReader.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// Bytes pulled from the stream whenever the text runs out mid-record
+static const size_t READ_BYTES = 1 << 20;
+
+CSVBatchReader::CSVBatchReader(const std::string &path, size_t batchRows, const CSVOptions &options)
+: file(new std::ifstream(path, std::ios::binary)), in(*file), options(options), batchRows(std::max<size_t>(batchRows, 1)) {
+    if (!*file) {
+        throw std::runtime_error("cannot open file: " + path);
+    }
+    readHeader();
+}
+
+CSVBatchReader::CSVBatchReader(std::istream &in, size_t batchRows, const CSVOptions &options)
+: in(in), options(options), batchRows(std::max<size_t>(batchRows, 1)) {
+    readHeader();
+}
+
+const std::vector<std::string> &CSVBatchReader::getHeaders() const {
+    return headers;
+}
+
+// Appends the next piece of the stream to the text, false at the end of input
+bool CSVBatchReader::readMore() {
+    if (!in.good()) {
+        return false;
+    }
+    size_t used = text->size();
+    text->resize(used + READ_BYTES);
+    in.read(&(*text)[used], READ_BYTES);
+    text->resize(used + static_cast<size_t>(in.gcount()));
+    return in.gcount() > 0;
+}
+
+// Returns the length of the first count records of the text, reading more of
+// the stream as needed. Blank lines are passed over but not counted when
+// skipBlank is set, found is the number of records counted.
+size_t CSVBatchReader::findRecords(size_t count, bool skipBlank, size_t &found) {
+    size_t pos = 0;
+    found = 0;
+    while (found < count) {
+        const char *begin = text->data();
+        bool complete;
+        const char *recordEnd = CSVReader::findRecordEnd(begin + pos, begin + text->size(), options, complete);
+        if (!complete) {
+            if (readMore()) {
+                continue;
+            }
+            // Without more input the rest of the text is the last record
+            if (pos < text->size()) {
+                ++found;
+            }
+            return text->size();
+        }
+        size_t length = recordEnd - (begin + pos);
+        bool blank = length == 1 || (length == 2 && begin[pos] == '\r');
+        if (!skipBlank || !blank) {
+            ++found;
+        }
+        pos += length;
+    }
+    return pos;
+}
+
+void CSVBatchReader::readHeader() {
+    text = std::make_shared<std::string>();
+    size_t found;
+    size_t length = findRecords(static_cast<size_t>(std::max(options.rowSkip, 0)) + 1, false, found);
+    // Skip a UTF-8 byte order mark
+    size_t start = text->compare(0, 3, "\xEF\xBB\xBF") == 0 ? 3 : 0;
+    reader = std::make_unique<CSVReader>(text, text->data() + std::min(start, length), text->data() + length, options);
+    if (!reader->readHeader(headers)) {
+        headers.clear();
+    }
+    reader->setRange(nullptr, nullptr, nullptr);
+    carry.assign(*text, length, std::string::npos);
+    text->clear();
+}
+
+// Fills batch with the next rows, false once the input is exhausted
+bool CSVBatchReader::next(Dataframe &batch) {
+    std::vector<Column> columns = std::move(batch.columns);
+    batch.columns.clear();
+    batch.headers = headers;
+    batch.rowCount = 0;
+    if (columns.size() != headers.size()) {
+        columns.clear();
+        for (const auto &header : headers) {
+            const std::vector<std::string> &categorical = options.categoricalColumns;
+            bool isCategorical = std::find(categorical.begin(), categorical.end(), header) != categorical.end();
+            columns.emplace_back(isCategorical ? ColumnType::Categorical : ColumnType::String);
+        }
+    }
+    for (auto &column : columns) {
+        column.clear();
+    }
+    // The text buffer is reused unless an earlier batch still refers to it
+    if (text.use_count() > 1) {
+        text = std::make_shared<std::string>();
+    }
+    text->assign(carry);
+    carry.clear();
+
+    size_t rows;
+    size_t length = findRecords(batchRows, true, rows);
+    carry.assign(*text, length, std::string::npos);
+    text->resize(length);
+    if (rows == 0 || headers.empty()) {
+        batch.columns = std::move(columns);
+        return false;
+    }
+    // The reader keeps the header projection, its reference to the text is
+    // dropped again so the buffer can be reused
+    reader->setRange(text, text->data(), text->data() + text->size());
+    reader->readRows(columns);
+    reader->setRange(nullptr, nullptr, nullptr);
+    // Nulls are filled as the options ask, or as the batch itself was set to
+    const bool replacing = options.replaceNulls || batch.isReplacingNulls;
+    const std::string &replacement = options.replaceNulls ? options.nullReplacement : batch.nullReplacement;
+    for (auto &column : columns) {
+        column.inferType();
+        if (replacing) {
+            column.fillNull(replacement);
+        }
+    }
+    batch.rowCount = columns[0].size();
+    batch.columns = std::move(columns);
+    return true;
+}
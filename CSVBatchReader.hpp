@@ -0,0 +1,39 @@
+#ifndef CSVBATCHREADER_HPP
+#define CSVBATCHREADER_HPP
+
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "CSVReader.hpp"
+#include "dataframe.hpp"
+
+
+// Reads a CSV file or stream as a sequence of dataframes of at most batchRows
+// rows each, so inputs larger than memory can be processed piece by piece.
+// Only the text of the current batch is held. Passing the same dataframe to
+// next() reuses its columns and text buffer, and the column types found in one
+// batch are kept for the next as long as the values still fit.
+class CSVBatchReader {
+private:
+    std::unique_ptr<std::ifstream> file;
+    std::istream &in;
+    CSVOptions options;
+    size_t batchRows;
+    std::vector<std::string> headers;
+    std::unique_ptr<CSVReader> reader;
+    std::shared_ptr<std::string> text;
+    std::string carry;
+    bool readMore();
+    size_t findRecords(size_t count, bool skipBlank, size_t &found);
+    void readHeader();
+
+public:
+    CSVBatchReader(const std::string &path, size_t batchRows = 65536, const CSVOptions &options = CSVOptions());
+    CSVBatchReader(std::istream &in, size_t batchRows = 65536, const CSVOptions &options = CSVOptions());
+    const std::vector<std::string> &getHeaders() const;
+    bool next(Dataframe &batch);
+};
+
+#endif  // CSVBATCHREADER_HPP
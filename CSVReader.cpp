@@ -0,0 +1,571 @@
+#include "CSVReader.hpp"
+#include "CSVScanner.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string &path)
+: mapped(nullptr), length(0), fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr) {
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("cannot open file: " + path);
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(fileHandle, &fileSize);
+    length = static_cast<size_t>(fileSize.QuadPart);
+    if (length > 0) {
+        mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mappingHandle != nullptr) {
+            mapped = static_cast<const char *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (mapped == nullptr) {
+            release();
+            throw std::runtime_error("cannot map file: " + path);
+        }
+    }
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+void MappedFile::release() {
+    if (mapped != nullptr) {
+        UnmapViewOfFile(mapped);
+        mapped = nullptr;
+    }
+    if (mappingHandle != nullptr) {
+        CloseHandle(mappingHandle);
+        mappingHandle = nullptr;
+    }
+    if (fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(fileHandle);
+        fileHandle = INVALID_HANDLE_VALUE;
+    }
+}
+#else
+MappedFile::MappedFile(const std::string &path)
+: mapped(nullptr), length(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open file: " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("cannot read file size: " + path);
+    }
+    length = static_cast<size_t>(info.st_size);
+    if (length > 0) {
+        void *addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("cannot map file: " + path);
+        }
+        madvise(addr, length, MADV_SEQUENTIAL);
+        mapped = static_cast<const char *>(addr);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (mapped != nullptr) {
+        munmap(const_cast<char *>(mapped), length);
+    }
+}
+#endif
+
+const char *MappedFile::data() const {
+    return mapped;
+}
+
+size_t MappedFile::size() const {
+    return length;
+}
+
+CSVReader::CSVReader(const std::string &path, const CSVOptions &options)
+: options(options) {
+    auto file = std::make_shared<MappedFile>(path);
+    cursor = file->data();
+    end = cursor + file->size();
+    owner = std::move(file);
+    // Skip a UTF-8 byte order mark
+    if (end - cursor >= 3 && std::memcmp(cursor, "\xEF\xBB\xBF", 3) == 0) {
+        cursor += 3;
+    }
+}
+
+// Reads the bytes in [begin, end), which owner keeps alive for the cells that
+// are stored as views
+CSVReader::CSVReader(std::shared_ptr<const void> owner, const char *begin, const char *end, const CSVOptions &options)
+: owner(std::move(owner)), options(options), cursor(begin), end(end) {
+    //
+}
+
+// Parses the cell starting at p and returns the position after its separator
+// or line break, or stop when the data ends first. Quoted cells are returned without their quotes, escaped is set
+// when doubled quotes inside still need unescaping.
+const char *CSVReader::parseCell(const char *p, const char *stop, std::string_view &cell, bool &escaped, bool &recordEnd) const {
+    const char sep = options.sep;
+    const char quote = options.quoteChar;
+    escaped = false;
+    recordEnd = false;
+    if (p < stop && *p == quote) {
+        const char *start = ++p;
+        const char *close = stop;
+        while (p < stop) {
+            if (*p == quote) {
+                if (p + 1 < stop && p[1] == quote) {
+                    escaped = true;
+                    p += 2;
+                    continue;
+                }
+                close = p++;
+                break;
+            }
+            if (*p == '\n' && !options.quotedLinebreaks) {
+                close = p;
+                break;
+            }
+            ++p;
+        }
+        cell = std::string_view(start, (close == stop ? p : close) - start);
+        while (p < stop && *p != sep && *p != '\n') {
+            ++p;
+        }
+    }
+    else {
+        const char *start = p;
+        while (p < stop && *p != sep && *p != '\n') {
+            ++p;
+        }
+        cell = std::string_view(start, p - start);
+    }
+    if (p >= stop || *p == '\n') {
+        recordEnd = true;
+        if (!cell.empty() && cell.back() == '\r' && cell.data() + cell.size() == p) {
+            cell.remove_suffix(1);
+        }
+    }
+    return p < stop ? p + 1 : p;
+}
+
+// Extracts the quoted cell spanning [p, stop) that the scanner delimited
+void CSVReader::quotedCell(const char *p, const char *stop, std::string_view &cell, bool &escaped) const {
+    const char quote = options.quoteChar;
+    const char *start = ++p;
+    while (p < stop) {
+        if (*p == quote) {
+            if (p + 1 < stop && p[1] == quote) {
+                escaped = true;
+                p += 2;
+                continue;
+            }
+            break;
+        }
+        ++p;
+    }
+    cell = std::string_view(start, p - start);
+}
+
+std::string CSVReader::unescape(std::string_view cell, char quoteChar) {
+    std::string result;
+    result.reserve(cell.size());
+    for (size_t i = 0; i < cell.size(); ++i) {
+        result += cell[i];
+        if (cell[i] == quoteChar && i + 1 < cell.size() && cell[i + 1] == quoteChar) {
+            ++i;
+        }
+    }
+    return result;
+}
+
+// Reads one record into owned strings, used for the skipped rows and the header
+bool CSVReader::readRecord(std::vector<std::string> &cells) {
+    cells.clear();
+    if (cursor >= end) {
+        return false;
+    }
+    bool recordEnd = false;
+    while (!recordEnd) {
+        std::string_view cell;
+        bool escaped;
+        cursor = parseCell(cursor, end, cell, escaped, recordEnd);
+        cells.push_back(escaped ? unescape(cell, options.quoteChar) : std::string(cell));
+    }
+    return true;
+}
+
+// Chunks smaller than this are not worth a thread of their own
+static const size_t MIN_CHUNK_BYTES = 1 << 20;
+
+// Skips the rowSkip records and reads the header, false when there is none.
+// Only the headers of the columns kept by projection are returned.
+bool CSVReader::readHeader(std::vector<std::string> &headers) {
+    std::vector<std::string> skipped;
+    for (int i = 0; i < options.rowSkip; ++i) {
+        readRecord(skipped);
+    }
+    if (!readRecord(headers)) {
+        return false;
+    }
+    project(headers);
+    return true;
+}
+
+// Maps each file column to its position among the columns kept by
+// useColumns and useColumnIndices, or -1 when it is skipped. No selection
+// keeps every column. Filter columns are looked up among all columns.
+void CSVReader::project(std::vector<std::string> &headers) {
+    const size_t colCount = headers.size();
+    targets.assign(colCount, -1);
+    std::vector<bool> kept(colCount, options.useColumns.empty() && options.useColumnIndices.empty());
+    for (const auto &name : options.useColumns) {
+        auto it = std::find(headers.begin(), headers.end(), name);
+        if (it == headers.end()) {
+            throw std::out_of_range("column not found: " + name);
+        }
+        kept[it - headers.begin()] = true;
+    }
+    for (size_t index : options.useColumnIndices) {
+        if (index >= colCount) {
+            throw std::out_of_range("column index out of range: " + std::to_string(index));
+        }
+        kept[index] = true;
+    }
+    filterColumns.clear();
+    for (const auto &filter : options.filters) {
+        auto it = std::find(headers.begin(), headers.end(), filter.column);
+        if (it == headers.end()) {
+            throw std::out_of_range("column not found: " + filter.column);
+        }
+        filterColumns.push_back(it - headers.begin());
+    }
+    std::vector<std::string> projected;
+    for (size_t col = 0; col < colCount; ++col) {
+        if (kept[col]) {
+            targets[col] = static_cast<int>(projected.size());
+            projected.push_back(std::move(headers[col]));
+        }
+    }
+    headers.swap(projected);
+}
+
+// Points the reader at another block of rows, keeping the header projection
+void CSVReader::setRange(std::shared_ptr<const void> owner, const char *begin, const char *end) {
+    this->owner = std::move(owner);
+    cursor = begin;
+    this->end = end;
+}
+
+void CSVReader::read(std::vector<std::string> &headers, std::vector<Column> &columns) {
+    columns.clear();
+    if (!readHeader(headers)) {
+        headers.clear();
+        return;
+    }
+    size_t chunkCount = std::min<size_t>(threadCount(options.threads), (end - cursor) / MIN_CHUNK_BYTES);
+    std::vector<const char *> bounds = splitChunks(std::max<size_t>(chunkCount, 1));
+    chunkCount = bounds.size() - 1;
+
+    // Each chunk starts on a record boundary and is parsed into its own fragment
+    std::vector<std::vector<Column>> fragments(chunkCount);
+    std::vector<char> complete(chunkCount);
+    parallelFor(chunkCount, static_cast<unsigned>(chunkCount), [&](size_t i) {
+        fragments[i] = createColumns(headers);
+        complete[i] = parseRange(bounds[i], bounds[i + 1], fragments[i]);
+    });
+    // A chunk that ends inside a record means the split guessed wrong, the
+    // rest of the file is then parsed in one piece
+    for (size_t i = 0; i + 1 < chunkCount; ++i) {
+        if (!complete[i]) {
+            fragments[i] = createColumns(headers);
+            parseRange(bounds[i], end, fragments[i]);
+            fragments.resize(i + 1);
+            break;
+        }
+    }
+
+    // Stitching keeps the cell views, the text stays in the mapping
+    columns = std::move(fragments[0]);
+    if (fragments.size() == 1) {
+        cursor = end;
+        return;
+    }
+    size_t rows = 0;
+    for (const auto &fragment : fragments) {
+        rows += fragment.empty() ? 0 : fragment[0].size();
+    }
+    parallelFor(columns.size(), threadCount(options.threads), [&](size_t col) {
+        columns[col].reserve(rows);
+        for (size_t i = 1; i < fragments.size(); ++i) {
+            columns[col].append(fragments[i][col]);
+        }
+    });
+    cursor = end;
+}
+
+// Parses the remaining records on the calling thread into existing columns,
+// which keep the values of their current type
+void CSVReader::readRows(std::vector<Column> &columns) {
+    for (auto &column : columns) {
+        column.addOwner(owner);
+    }
+    parseRange(cursor, end, columns);
+    cursor = end;
+}
+
+// Returns the position after the record starting at p. complete is false when
+// the data ends before the line break that closes the record.
+const char *CSVReader::findRecordEnd(const char *p, const char *end, const CSVOptions &options, bool &complete) {
+    complete = false;
+    while (p < end) {
+        if (*p == options.quoteChar) {
+            for (++p; p < end; ++p) {
+                if (*p == options.quoteChar) {
+                    if (p + 1 < end && p[1] == options.quoteChar) {
+                        ++p;
+                        continue;
+                    }
+                    ++p;
+                    break;
+                }
+                if (*p == '\n' && !options.quotedLinebreaks) {
+                    break;
+                }
+            }
+        }
+        while (p < end && *p != options.sep && *p != '\n') {
+            ++p;
+        }
+        if (p < end && *p == '\n') {
+            complete = true;
+            return p + 1;
+        }
+        if (p < end) {
+            ++p;
+        }
+    }
+    return end;
+}
+
+std::vector<Column> CSVReader::createColumns(const std::vector<std::string> &headers) const {
+    std::vector<Column> columns;
+    columns.reserve(headers.size());
+    for (const auto &header : headers) {
+        const std::vector<std::string> &categorical = options.categoricalColumns;
+        if (std::find(categorical.begin(), categorical.end(), header) != categorical.end()) {
+            columns.emplace_back(ColumnType::Categorical);
+        }
+        else {
+            columns.emplace_back(ColumnType::String);
+            columns.back().addOwner(owner);
+        }
+    }
+    return columns;
+}
+
+// Picks up to count - 1 record boundaries spread evenly over the data. Without
+// quoted linebreaks every line break ends a record. With them, the quotes
+// before each candidate line break are counted in parallel and only a line
+// break outside quotes is taken.
+std::vector<const char *> CSVReader::splitChunks(size_t count) const {
+    std::vector<const char *> bounds(1, cursor);
+    const size_t length = end - cursor;
+    if (!options.quotedLinebreaks) {
+        for (size_t i = 1; i < count; ++i) {
+            const char *target = std::max(cursor + length * i / count, bounds.back());
+            const char *newline = static_cast<const char *>(std::memchr(target, '\n', end - target));
+            if (newline == nullptr || newline + 1 >= end) {
+                break;
+            }
+            bounds.push_back(newline + 1);
+        }
+    }
+    else if (count > 1) {
+        // For each slice: its quote count and the first line break reached
+        // after an even and after an odd number of quotes
+        std::vector<size_t> quotes(count, 0);
+        std::vector<const char *> evenBreak(count, nullptr);
+        std::vector<const char *> oddBreak(count, nullptr);
+        parallelFor(count, static_cast<unsigned>(count), [&](size_t i) {
+            const char *p = cursor + length * i / count;
+            const char *stop = cursor + length * (i + 1) / count;
+            size_t seen = 0;
+            for (; p < stop; ++p) {
+                if (*p == options.quoteChar) {
+                    ++seen;
+                }
+                else if (*p == '\n') {
+                    const char *&first = seen % 2 == 0 ? evenBreak[i] : oddBreak[i];
+                    if (first == nullptr) {
+                        first = p;
+                    }
+                }
+            }
+            quotes[i] = seen;
+        });
+        size_t before = quotes[0];
+        for (size_t i = 1; i < count; ++i) {
+            const char *newline = before % 2 == 0 ? evenBreak[i] : oddBreak[i];
+            before += quotes[i];
+            if (newline != nullptr && newline + 1 < end && newline + 1 > bounds.back()) {
+                bounds.push_back(newline + 1);
+            }
+        }
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+// Parses the records in [begin, stop) into the projected columns. Returns false
+// when the last record runs into stop without a line break, so that stop may
+// not be a record boundary after all.
+bool CSVReader::parseRange(const char *begin, const char *stop, std::vector<Column> &columns) const {
+    const size_t colCount = columns.size();
+    // Line breaks bound the row count, counting them is cheap next to parsing
+    size_t estimate = std::count(begin, stop, '\n') + 1;
+    for (auto &column : columns) {
+        column.reserve(estimate);
+    }
+
+    const char *p = begin;
+    CSVScanner scanner(stop, options.sep, options.quoteChar, options.quotedLinebreaks);
+    scanner.reset(p);
+    // Cell ends of the current record, or its cells when tokenized by hand
+    std::vector<const char *> stops;
+    std::vector<std::pair<std::string_view, bool>> cells;
+    bool irregular = false;
+    const char *recordStart = p;
+    auto cellAt = [&](size_t col, std::string_view &cell, bool &escaped) {
+        escaped = false;
+        if (irregular) {
+            if (col >= cells.size()) {
+                return false;
+            }
+            cell = cells[col].first;
+            escaped = cells[col].second;
+            return true;
+        }
+        if (col >= stops.size()) {
+            return false;
+        }
+        const char *cellStart = col == 0 ? recordStart : stops[col - 1] + 1;
+        const char *cellEnd = stops[col];
+        if (cellStart < cellEnd && *cellStart == options.quoteChar) {
+            quotedCell(cellStart, cellEnd, cell, escaped);
+        }
+        else {
+            cell = std::string_view(cellStart, cellEnd - cellStart);
+        }
+        if (col + 1 == stops.size() && !cell.empty() && cell.back() == '\r' && cell.data() + cell.size() == cellEnd) {
+            cell.remove_suffix(1);
+        }
+        return true;
+    };
+    // Rows failing a filter are dropped before any of their cells is stored
+    std::string unescaped;
+    auto keepRecord = [&]() {
+        for (size_t i = 0; i < options.filters.size(); ++i) {
+            std::string_view cell;
+            bool escaped;
+            if (!cellAt(filterColumns[i], cell, escaped)) {
+                cell = std::string_view();
+            }
+            else if (escaped) {
+                unescaped = unescape(cell, options.quoteChar);
+                cell = unescaped;
+            }
+            if (cell == "NaN") {
+                cell = std::string_view();
+            }
+            if (!options.filters[i].matches(cell)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    bool cut = false;
+    while (p < stop) {
+        // Blank lines carry no record
+        if (*p == '\n' || (*p == '\r' && p + 1 < stop && p[1] == '\n')) {
+            p += *p == '\n' ? 1 : 2;
+            cut = false;
+            scanner.reset(p);
+            continue;
+        }
+        recordStart = p;
+        stops.clear();
+        bool newline = false;
+        do {
+            stops.push_back(scanner.next(newline));
+        } while (!newline && stops.back() != stop);
+
+        irregular = scanner.isIrregular();
+        if (irregular) {
+            // Quotes the scanner cannot follow, tokenize this record by hand
+            cells.clear();
+            bool recordEnd = false;
+            while (!recordEnd) {
+                std::string_view cell;
+                bool escaped;
+                p = parseCell(p, stop, cell, escaped, recordEnd);
+                cells.emplace_back(cell, escaped);
+            }
+            // A cell that reaches stop was cut off rather than ended by a line break
+            cut = cells.back().first.data() + cells.back().first.size() == stop;
+            scanner.reset(p);
+        }
+        else {
+            const char *last = stops.back();
+            p = last < stop ? last + 1 : stop;
+            cut = !newline;
+        }
+        if (!options.filters.empty() && !keepRecord()) {
+            continue;
+        }
+
+        // Cells are only converted and stored for the columns kept by
+        // projection, which come in file order
+        size_t filled = 0;
+        for (size_t col = 0; col < targets.size() && filled < colCount; ++col) {
+            if (targets[col] < 0) {
+                continue;
+            }
+            std::string_view cell;
+            bool escaped;
+            if (!cellAt(col, cell, escaped)) {
+                break;
+            }
+            Column &column = columns[targets[col]];
+            // "NaN" is read as a missing value like an empty cell
+            if (cell == "NaN") {
+                column.pushNull();
+            }
+            else if (escaped) {
+                column.push_back(unescape(cell, options.quoteChar));
+            }
+            else {
+                column.pushView(cell);
+            }
+            ++filled;
+        }
+        for (; filled < colCount; ++filled) {
+            columns[filled].pushNull();
+        }
+    }
+    return !cut;
+}
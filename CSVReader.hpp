@@ -0,0 +1,83 @@
+#ifndef CSVREADER_HPP
+#define CSVREADER_HPP
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Column.hpp"
+#include "Predicate.hpp"
+
+
+struct CSVOptions {
+    char sep = ',';
+    int rowSkip = 0;
+    char quoteChar = '"';
+    bool quotedLinebreaks = false;
+    std::vector<std::string> categoricalColumns;
+    // Columns to load by name or position, both empty loads every column
+    std::vector<std::string> useColumns;
+    std::vector<size_t> useColumnIndices;
+    // Only rows matching every filter are loaded
+    std::vector<Predicate> filters;
+    // Parser threads, 0 uses one per hardware thread
+    unsigned threads = 0;
+    // Nulls are kept unless replaceNulls, which fills them with nullReplacement
+    // once the column types are inferred
+    bool replaceNulls = false;
+    std::string nullReplacement = "0";
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+private:
+    const char *mapped;
+    size_t length;
+#ifdef _WIN32
+    void *fileHandle;
+    void *mappingHandle;
+    void release();
+#endif
+
+public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    const char *data() const;
+    size_t size() const;
+};
+
+// Tokenizes a mapped CSV file in place. Cell boundaries come from the SIMD
+// scanner, records it flags as irregular are parsed by the scalar tokenizer.
+// Large files are split at record boundaries and the chunks parsed on separate
+// threads. Cells that need no unescaping are stored in the columns as views
+// into the mapping, which the string columns keep alive.
+class CSVReader {
+private:
+    std::shared_ptr<const void> owner;
+    CSVOptions options;
+    const char *cursor;
+    const char *end;
+    std::vector<int> targets;
+    std::vector<size_t> filterColumns;
+    void project(std::vector<std::string> &headers);
+    const char *parseCell(const char *p, const char *stop, std::string_view &cell, bool &escaped, bool &recordEnd) const;
+    void quotedCell(const char *p, const char *stop, std::string_view &cell, bool &escaped) const;
+    bool readRecord(std::vector<std::string> &cells);
+    std::vector<Column> createColumns(const std::vector<std::string> &headers) const;
+    std::vector<const char *> splitChunks(size_t count) const;
+    bool parseRange(const char *begin, const char *stop, std::vector<Column> &columns) const;
+    static std::string unescape(std::string_view cell, char quoteChar);
+
+public:
+    CSVReader(const std::string &path, const CSVOptions &options);
+    CSVReader(std::shared_ptr<const void> owner, const char *begin, const char *end, const CSVOptions &options);
+    bool readHeader(std::vector<std::string> &headers);
+    void setRange(std::shared_ptr<const void> owner, const char *begin, const char *end);
+    void read(std::vector<std::string> &headers, std::vector<Column> &columns);
+    void readRows(std::vector<Column> &columns);
+    static const char *findRecordEnd(const char *p, const char *end, const CSVOptions &options, bool &complete);
+};
+
+#endif  // CSVREADER_HPP
@@ -11,32 +11,31 @@
 #include <vector>
 #include <algorithm>
 
+class Dataframe;
 
+// Lightweight view of a single row of a Dataframe. The row does not own any
+// data, it reads and writes through the columns of the dataframe it points to.
 class CSVRow {
 private:
-    int rowID;
-    bool replaceNulls;
-    std::string nullReplacement;
-    std::unordered_map<std::string, std::string> CSVData;
+    Dataframe *df;
+    size_t rowID;
 
 public:
     CSVRow();
-    CSVRow(int row, bool replace, std::string nullReplacement);
+    CSVRow(Dataframe *df, size_t row);
     struct Hash;
     bool operator==(const CSVRow &other) const;
+    size_t getRowID() const;
+    Dataframe *getDataframe() const;
     int getIndex(std::vector<CSVRow> &rows);
-    void deepCopyData(const CSVRow &other);
-    void addItem(std::string col, std::string val);
     void printRow(const std::vector<std::string> &headers);
-    void removeNull(std::vector<std::string> colNames, std::string replace);
-    std::string getData(std::string col);
-    void setData(std::string data, std::string col);
-    void dropCols(std::vector<std::string> cols);
+    std::string getData(const std::string &col) const;
+    bool isNull(const std::string &col) const;
+    void setData(const std::string &data, const std::string &col);
     std::string sumNumericalData(std::vector<std::string> &colNames);
     std::string subtractNumericalData(std::string col1, std::string col2);
-    void renameCol(std::string oldCol, std::string newCol);
     int matchCount(const std::string &eq);
-    std::string getRowStr(std::vector<std::string> header, char sep);
+    std::string getRowStr(const std::vector<std::string> &header, char sep);
 };
 
-#endif  // CSVROW_HPP
\ No newline at end of file
+#endif  // CSVROW_HPP
@@ -0,0 +1,162 @@
+#include "CSVScanner.hpp"
+#include "utils.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CSV_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CSV_SSE2
+#endif
+
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+typedef void (*MaskFunction)(const char *p, char sep, char quote, uint64_t &seps, uint64_t &newlines, uint64_t &quotes);
+
+#ifndef CSV_SSE2
+static void scalarMasks(const char *p, char sep, char quote, uint64_t &seps, uint64_t &newlines, uint64_t &quotes) {
+    seps = 0;
+    newlines = 0;
+    quotes = 0;
+    for (int i = 0; i < 64; ++i) {
+        seps |= static_cast<uint64_t>(p[i] == sep) << i;
+        newlines |= static_cast<uint64_t>(p[i] == '\n') << i;
+        quotes |= static_cast<uint64_t>(p[i] == quote) << i;
+    }
+}
+#endif
+
+#ifdef CSV_SSE2
+static void sse2Masks(const char *p, char sep, char quote, uint64_t &seps, uint64_t &newlines, uint64_t &quotes) {
+    const __m128i sepVec = _mm_set1_epi8(sep);
+    const __m128i newlineVec = _mm_set1_epi8('\n');
+    const __m128i quoteVec = _mm_set1_epi8(quote);
+    seps = 0;
+    newlines = 0;
+    quotes = 0;
+    for (int i = 0; i < 64; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        seps |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, sepVec))) << i;
+        newlines |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newlineVec))) << i;
+        quotes |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quoteVec))) << i;
+    }
+}
+#endif
+
+#ifdef CSV_X86
+TARGET_AVX2 static uint64_t avx2Mask(__m256i lo, __m256i hi, __m256i needle) {
+    uint32_t low = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle)));
+    uint32_t high = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)));
+    return static_cast<uint64_t>(low) | (static_cast<uint64_t>(high) << 32);
+}
+
+TARGET_AVX2 static void avx2Masks(const char *p, char sep, char quote, uint64_t &seps, uint64_t &newlines, uint64_t &quotes) {
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+    seps = avx2Mask(lo, hi, _mm256_set1_epi8(sep));
+    newlines = avx2Mask(lo, hi, _mm256_set1_epi8('\n'));
+    quotes = avx2Mask(lo, hi, _mm256_set1_epi8(quote));
+}
+#endif
+
+static MaskFunction selectMasks() {
+#ifdef CSV_X86
+    if (cpuHasAVX2()) {
+        return avx2Masks;
+    }
+#endif
+#ifdef CSV_SSE2
+    return sse2Masks;
+#else
+    return scalarMasks;
+#endif
+}
+
+static const MaskFunction computeMasks = selectMasks();
+
+// Bit i of the result is the xor of bits 0..i, so bytes between an opening
+// and a closing quote are set
+static uint64_t prefixXor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+CSVScanner::CSVScanner(const char *end, char sep, char quote, bool quotedLinebreaks)
+: end(end), sep(sep), quote(quote), quotedLinebreaks(quotedLinebreaks) {
+    reset(end);
+}
+
+// Restarts scanning at p, which must be the start of a record
+void CSVScanner::reset(const char *p) {
+    block = p;
+    quoteCarry = 0;
+    startCarry = 1;
+    closerCarry = 0;
+    irregular = false;
+    scanBlock();
+}
+
+void CSVScanner::scanBlock() {
+    uint64_t seps = 0;
+    uint64_t quotes = 0;
+    newlines = 0;
+    if (end - block >= 64) {
+        computeMasks(block, sep, quote, seps, newlines, quotes);
+    }
+    else if (end > block) {
+        // The tail is copied to a padded block and the padding masked off
+        char tail[64] = {};
+        size_t available = end - block;
+        std::memcpy(tail, block, available);
+        computeMasks(tail, sep, quote, seps, newlines, quotes);
+        uint64_t valid = (1ULL << available) - 1;
+        seps &= valid;
+        newlines &= valid;
+        quotes &= valid;
+    }
+    uint64_t inQuotes = prefixXor(quotes) ^ quoteCarry;
+    quoteCarry = static_cast<uint64_t>(-static_cast<int64_t>(inQuotes >> 63));
+    uint64_t structural = (seps | newlines) & ~inQuotes;
+    uint64_t openers = quotes & inQuotes;
+    uint64_t closers = quotes & ~inQuotes;
+    // A quote may open a cell, or follow a closing quote as an escaped pair
+    uint64_t allowed = (structural << 1) | startCarry | (closers << 1) | closerCarry;
+    if ((openers & ~allowed) != 0 || (!quotedLinebreaks && (newlines & inQuotes) != 0)) {
+        irregular = true;
+    }
+    startCarry = structural >> 63;
+    closerCarry = closers >> 63;
+    pending = structural;
+    newlines &= structural;
+}
+
+// Returns the next cell terminator, or end when the data runs out
+const char *CSVScanner::next(bool &newline) {
+    while (pending == 0) {
+        if (end - block <= 64) {
+            newline = false;
+            return end;
+        }
+        block += 64;
+        scanBlock();
+    }
+    int bit = lowestBit(pending);
+    pending &= pending - 1;
+    newline = ((newlines >> bit) & 1ULL) != 0;
+    return block + bit;
+}
+
+bool CSVScanner::isIrregular() const {
+    return irregular;
+}
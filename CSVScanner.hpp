@@ -0,0 +1,35 @@
+#ifndef CSVSCANNER_HPP
+#define CSVSCANNER_HPP
+
+#include <cstdint>
+
+
+// Finds the separators and line breaks that end cells, 64 bytes at a time.
+// Each block is turned into bitmasks of separators, line breaks and quotes with
+// SIMD compares; the quoted regions come from a prefix xor of the quote mask.
+// A block is marked irregular when a quote opens anywhere but at the start of a
+// cell (or a line break falls inside quotes without quoted linebreaks), and the
+// caller must then parse the affected record with the scalar tokenizer.
+class CSVScanner {
+private:
+    const char *end;
+    char sep;
+    char quote;
+    bool quotedLinebreaks;
+    const char *block;
+    uint64_t pending;
+    uint64_t newlines;
+    uint64_t quoteCarry;
+    uint64_t startCarry;
+    uint64_t closerCarry;
+    bool irregular;
+    void scanBlock();
+
+public:
+    CSVScanner(const char *end, char sep, char quote, bool quotedLinebreaks);
+    void reset(const char *p);
+    const char *next(bool &newline);
+    bool isIrregular() const;
+};
+
+#endif  // CSVSCANNER_HPP
@@ -0,0 +1,102 @@
+#include "CSVWriter.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+CSVWriter::CSVWriter(std::ostream &out, char sep, unsigned threads, char quoteChar)
+: out(out), sep(sep), quoteChar(quoteChar), threads(threadCount(threads)) {
+    // Formatted numbers only need the quoting check if the separator can
+    // appear in them
+    quoteNumbers = std::strchr("0123456789+-.eEinfaN", sep) != nullptr;
+}
+
+void CSVWriter::appendCell(std::string &buffer, std::string_view cell) const {
+    bool needsQuotes = false;
+    for (char c : cell) {
+        if (c == sep || c == quoteChar || c == '\n' || c == '\r') {
+            needsQuotes = true;
+            break;
+        }
+    }
+    if (!needsQuotes) {
+        buffer.append(cell.data(), cell.size());
+        return;
+    }
+    buffer += quoteChar;
+    for (char c : cell) {
+        if (c == quoteChar) {
+            buffer += quoteChar;
+        }
+        buffer += c;
+    }
+    buffer += quoteChar;
+}
+
+// Appends the rows in [begin, end) to buffer, nulls are left empty
+void CSVWriter::formatRows(std::string &buffer, const std::vector<Column> &columns, size_t begin, size_t end) const {
+    char number[128];
+    auto appendNumber = [&](const char *last) {
+        if (quoteNumbers) {
+            appendCell(buffer, std::string_view(number, last - number));
+        }
+        else {
+            buffer.append(number, last - number);
+        }
+    };
+    for (size_t row = begin; row < end; ++row) {
+        for (size_t col = 0; col < columns.size(); ++col) {
+            if (col > 0) {
+                buffer += sep;
+            }
+            const Column &column = columns[col];
+            if (column.isNull(row)) {
+                continue;
+            }
+            switch (column.getType()) {
+                case ColumnType::Int64:
+                    appendNumber(std::to_chars(number, number + sizeof(number), column.intData()[row]).ptr);
+                    break;
+                case ColumnType::Double: {
+                    double value = column.doubleData()[row];
+                    const char *last = writeDouble(number, number + sizeof(number), value, column.getPrecision());
+                    if (last != nullptr) {
+                        appendNumber(last);
+                    }
+                    else {
+                        appendCell(buffer, formatDouble(value, column.getPrecision()));
+                    }
+                    break;
+                }
+                case ColumnType::Bool:
+                    appendCell(buffer, column.boolData()[row] ? "true" : "false");
+                    break;
+                case ColumnType::Categorical:
+                    appendCell(buffer, column.dictionaryData()[column.codeData()[row]]);
+                    break;
+                default:
+                    appendCell(buffer, column.stringData()[row]);
+                    break;
+            }
+        }
+        buffer += '\n';
+    }
+}
+
+void CSVWriter::writeHeader(const std::vector<std::string> &headers) {
+    std::string line;
+    for (size_t i = 0; i < headers.size(); ++i) {
+        if (i > 0) {
+            line += sep;
+        }
+        appendCell(line, headers[i]);
+    }
+    line += '\n';
+    out.write(line.data(), line.size());
+}
+
+void CSVWriter::writeRows(const std::vector<Column> &columns, size_t rowCount) {
+    writeBlocks(out, rowCount, threads, [&](std::string &buffer, size_t begin, size_t end) {
+        formatRows(buffer, columns, begin, end);
+    });
+}
@@ -0,0 +1,32 @@
+#ifndef CSVWRITER_HPP
+#define CSVWRITER_HPP
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Column.hpp"
+
+
+// Writes columns as CSV text. Rows are formatted straight from the column
+// storage into large buffers that are reused, numbers with to_chars. With more
+// than one thread, ranges of rows are formatted in parallel and written in
+// order. Cells holding the separator, a quote or a line break are quoted, with
+// their quotes doubled.
+class CSVWriter {
+private:
+    std::ostream &out;
+    char sep;
+    char quoteChar;
+    unsigned threads;
+    bool quoteNumbers;
+    void appendCell(std::string &buffer, std::string_view cell) const;
+    void formatRows(std::string &buffer, const std::vector<Column> &columns, size_t begin, size_t end) const;
+
+public:
+    CSVWriter(std::ostream &out, char sep = ',', unsigned threads = 1, char quoteChar = '"');
+    void writeHeader(const std::vector<std::string> &headers);
+    void writeRows(const std::vector<Column> &columns, size_t rowCount);
+};
+
+#endif  // CSVWRITER_HPP
@@ -0,0 +1,759 @@
+#include "Column.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+Column::Column()
+: type(ColumnType::String), precision(-1), nulls(0) {
+    //
+}
+
+Column::Column(ColumnType type)
+: type(type), precision(-1), nulls(0) {
+    //
+}
+
+Column::Column(size_t size, std::string_view fill)
+: type(ColumnType::String), precision(-1), nulls(0) {
+    resize(size, fill);
+}
+
+template<typename T>
+static void gather(const std::vector<T> &values, const std::vector<size_t> &indices, std::vector<T> &selected) {
+    selected.reserve(indices.size());
+    for (size_t idx : indices) {
+        selected.push_back(values[idx]);
+    }
+}
+
+template<typename T>
+static void gather(std::vector<T> &values, const std::vector<size_t> &indices) {
+    std::vector<T> selected;
+    gather(values, indices, selected);
+    values.swap(selected);
+}
+
+// Moves the values whose bit is set in mask to the front, in order, and drops
+// the rest. Full words are copied as one block.
+template<typename T>
+static void compactValues(std::vector<T> &values, const std::vector<uint64_t> &mask) {
+    size_t count = values.size();
+    size_t out = 0;
+    for (size_t base = 0; base < count; base += 64) {
+        uint64_t word = mask[base / 64];
+        if (count - base < 64) {
+            word &= (1ULL << (count - base)) - 1;
+        }
+        if (word == ~0ULL) {
+            if (out != base) {
+                std::copy(values.begin() + base, values.begin() + base + 64, values.begin() + out);
+            }
+            out += 64;
+            continue;
+        }
+        while (word != 0) {
+            values[out++] = values[base + lowestBit(word)];
+            word &= word - 1;
+        }
+    }
+    values.resize(out);
+}
+
+static ColumnType commonType(ColumnType a, ColumnType b) {
+    if (a == b) {
+        return a;
+    }
+    if ((a == ColumnType::Int64 || a == ColumnType::Double) && (b == ColumnType::Int64 || b == ColumnType::Double)) {
+        return ColumnType::Double;
+    }
+    if ((a == ColumnType::Categorical && b == ColumnType::String) || (a == ColumnType::String && b == ColumnType::Categorical)) {
+        return ColumnType::Categorical;
+    }
+    return ColumnType::String;
+}
+
+ColumnType Column::getType() const {
+    return type;
+}
+
+bool Column::isNumeric() const {
+    return type == ColumnType::Int64 || type == ColumnType::Double;
+}
+
+size_t Column::size() const {
+    switch (type) {
+        case ColumnType::Int64: return ints.size();
+        case ColumnType::Double: return doubles.size();
+        case ColumnType::Bool: return bools.size();
+        case ColumnType::Categorical: return codes.size();
+        default: return strings.size();
+    }
+}
+
+void Column::reserve(size_t n) {
+    switch (type) {
+        case ColumnType::Int64: ints.reserve(n); break;
+        case ColumnType::Double: doubles.reserve(n); break;
+        case ColumnType::Bool: bools.reserve(n); break;
+        case ColumnType::Categorical: codes.reserve(n); break;
+        default: strings.reserve(n); break;
+    }
+}
+
+// Drops every row but keeps the type and the allocated storage for reuse
+void Column::clear() {
+    ints.clear();
+    doubles.clear();
+    bools.clear();
+    strings.clear();
+    codes.clear();
+    dictionary.clear();
+    dictionaryIndex.clear();
+    buffer.reset();
+    owners.clear();
+    validity.clear();
+    nulls = 0;
+}
+
+void Column::resize(size_t n, std::string_view fill) {
+    // The fill value is converted once and its slot repeated
+    if (size() < n && !fill.empty()) {
+        push_back(fill);
+        switch (type) {
+            case ColumnType::Int64: ints.resize(n, ints.back()); break;
+            case ColumnType::Double: doubles.resize(n, doubles.back()); break;
+            case ColumnType::Bool: bools.resize(n, bools.back()); break;
+            case ColumnType::Categorical: codes.resize(n, codes.back()); break;
+            default: strings.resize(n, strings.back()); break;
+        }
+        if (!validity.empty()) {
+            materializeValidity();
+        }
+    }
+    while (size() < n) {
+        pushNull();
+    }
+    switch (type) {
+        case ColumnType::Int64: ints.resize(n); break;
+        case ColumnType::Double: doubles.resize(n); break;
+        case ColumnType::Bool: bools.resize(n); break;
+        case ColumnType::Categorical: codes.resize(n); break;
+        default: strings.resize(n); break;
+    }
+    if (!validity.empty()) {
+        validity.resize((n + 63) / 64);
+        if (n % 64 != 0) {
+            validity.back() |= ~0ULL << (n % 64);
+        }
+        nulls = 0;
+        for (uint64_t word : validity) {
+            nulls += popCount(~word);
+        }
+    }
+}
+
+// Picks the narrowest type able to hold every value of a string column
+void Column::inferType() {
+    if (type != ColumnType::String || nulls == strings.size()) {
+        return;
+    }
+    bool allInts = true;
+    bool allDoubles = true;
+    bool allBools = true;
+    int64_t i;
+    double d;
+    bool b;
+    for (size_t row = 0; row < strings.size(); ++row) {
+        if (isNull(row)) {
+            continue;
+        }
+        std::string_view s = strings[row];
+        allInts = allInts && parseInt64(s, i);
+        allDoubles = allDoubles && (allInts || parseDouble(s, d));
+        allBools = allBools && parseBool(s, b);
+        if (!allInts && !allDoubles && !allBools) {
+            return;
+        }
+    }
+    if (allInts) {
+        convertTo(ColumnType::Int64);
+    }
+    else if (allDoubles) {
+        convertTo(ColumnType::Double);
+    }
+    else {
+        convertTo(ColumnType::Bool);
+    }
+}
+
+// Throws std::invalid_argument when a string value does not fit the new type
+void Column::convertTo(ColumnType newType) {
+    if (newType == type) {
+        return;
+    }
+    size_t n = size();
+    Column converted(newType);
+    converted.precision = precision;
+    converted.reserve(n);
+    for (size_t row = 0; row < n; ++row) {
+        if (isNull(row)) {
+            converted.pushPlaceholder();
+            continue;
+        }
+        switch (newType) {
+            case ColumnType::Int64: converted.ints.push_back(getInt(row)); break;
+            case ColumnType::Double: converted.doubles.push_back(getDouble(row)); break;
+            case ColumnType::Bool: converted.bools.push_back(getBool(row)); break;
+            case ColumnType::Categorical: converted.codes.push_back(converted.encode(stringAt(row))); break;
+            default: {
+                if (type == ColumnType::Categorical) {
+                    converted.strings.push_back(stringAt(row));
+                }
+                else {
+                    converted.strings.push_back(converted.storeString(get(row)));
+                }
+                break;
+            }
+        }
+    }
+    if (type == ColumnType::Categorical) {
+        converted.shareOwners(*this);
+    }
+    converted.validity = std::move(validity);
+    converted.nulls = nulls;
+    *this = std::move(converted);
+}
+
+// Number of decimals used when printing a double column, -1 for shortest
+void Column::setPrecision(int digits) {
+    precision = digits;
+}
+
+int Column::getPrecision() const {
+    return precision;
+}
+
+void Column::push_back(std::string_view val) {
+    int64_t i;
+    double d;
+    bool b;
+    if (val.empty()) {
+        pushNull();
+        return;
+    }
+    if (type == ColumnType::Int64 && parseInt64(val, i)) {
+        ints.push_back(i);
+    }
+    else if (type == ColumnType::Double && parseDouble(val, d)) {
+        doubles.push_back(d);
+    }
+    else if (type == ColumnType::Bool && parseBool(val, b)) {
+        bools.push_back(b);
+    }
+    else if (type == ColumnType::Categorical) {
+        codes.push_back(encode(val));
+    }
+    else {
+        convertTo(ColumnType::String);
+        strings.push_back(storeString(val));
+    }
+    if (!validity.empty() && validity.size() * 64 < size()) {
+        validity.push_back(~0ULL);
+    }
+}
+
+// Appends a string cell without copying its bytes, the memory it points to
+// must be kept alive through addOwner
+void Column::pushView(std::string_view val) {
+    if (type != ColumnType::String) {
+        push_back(val);
+        return;
+    }
+    if (val.empty()) {
+        pushNull();
+        return;
+    }
+    strings.push_back(val);
+    if (!validity.empty() && validity.size() * 64 < size()) {
+        validity.push_back(~0ULL);
+    }
+}
+
+void Column::addOwner(std::shared_ptr<const void> owner) {
+    if (std::find(owners.begin(), owners.end(), owner) == owners.end()) {
+        owners.push_back(std::move(owner));
+    }
+}
+
+void Column::pushInt(int64_t val) {
+    if (type == ColumnType::Double) {
+        pushDouble(static_cast<double>(val));
+    }
+    else if (type == ColumnType::Int64) {
+        ints.push_back(val);
+        if (!validity.empty() && validity.size() * 64 < size()) {
+            validity.push_back(~0ULL);
+        }
+    }
+    else {
+        push_back(std::to_string(val));
+    }
+}
+
+void Column::pushDouble(double val) {
+    if (type == ColumnType::Int64) {
+        convertTo(ColumnType::Double);
+    }
+    if (type == ColumnType::Double) {
+        doubles.push_back(val);
+        if (!validity.empty() && validity.size() * 64 < size()) {
+            validity.push_back(~0ULL);
+        }
+    }
+    else {
+        push_back(formatDouble(val));
+    }
+}
+
+void Column::pushBool(bool val) {
+    push_back(val ? "true" : "false");
+}
+
+void Column::pushNull() {
+    pushPlaceholder();
+    markNull(size() - 1);
+}
+
+// Appends the value slot of a null row without touching the bitmap
+void Column::pushPlaceholder() {
+    switch (type) {
+        case ColumnType::Int64: ints.push_back(0); break;
+        case ColumnType::Double: doubles.push_back(0.); break;
+        case ColumnType::Bool: bools.push_back(0); break;
+        case ColumnType::Categorical: codes.push_back(-1); break;
+        default: strings.emplace_back(); break;
+    }
+}
+
+void Column::materializeValidity() {
+    if (validity.empty()) {
+        validity.assign((size() + 63) / 64, ~0ULL);
+    }
+    while (validity.size() * 64 < size()) {
+        validity.push_back(~0ULL);
+    }
+}
+
+void Column::markNull(size_t row) {
+    materializeValidity();
+    uint64_t bit = 1ULL << (row % 64);
+    if (validity[row / 64] & bit) {
+        validity[row / 64] &= ~bit;
+        ++nulls;
+    }
+}
+
+void Column::markValid(size_t row) {
+    if (validity.empty()) {
+        return;
+    }
+    uint64_t bit = 1ULL << (row % 64);
+    if (!(validity[row / 64] & bit)) {
+        validity[row / 64] |= bit;
+        --nulls;
+    }
+}
+
+bool Column::isNull(size_t row) const {
+    return !validity.empty() && !((validity[row / 64] >> (row % 64)) & 1ULL);
+}
+
+size_t Column::nullCount() const {
+    return nulls;
+}
+
+void Column::setNull(size_t row) {
+    switch (type) {
+        case ColumnType::Int64: ints[row] = 0; break;
+        case ColumnType::Double: doubles[row] = 0.; break;
+        case ColumnType::Bool: bools[row] = 0; break;
+        case ColumnType::Categorical: codes[row] = -1; break;
+        default: strings[row] = std::string_view(); break;
+    }
+    markNull(row);
+}
+
+// Writes the value into every null slot found in the bitmap, words without
+// nulls are skipped whole. Widens the column when the value does not fit.
+void Column::fillNull(std::string_view val) {
+    if (nulls == 0 || val.empty()) {
+        return;
+    }
+    int64_t i = 0;
+    double d = 0.;
+    bool b = false;
+    int32_t code = -1;
+    if (type == ColumnType::Int64 && !parseInt64(val, i)) {
+        convertTo(parseDouble(val, d) ? ColumnType::Double : ColumnType::String);
+    }
+    if (type == ColumnType::Double && !parseDouble(val, d)) {
+        convertTo(ColumnType::String);
+    }
+    if (type == ColumnType::Bool && !parseBool(val, b)) {
+        convertTo(ColumnType::String);
+    }
+    if (type == ColumnType::Categorical) {
+        code = encode(val);
+    }
+    if (type == ColumnType::String) {
+        val = storeString(val);
+    }
+    for (size_t word = 0; word < validity.size(); ++word) {
+        uint64_t missing = ~validity[word];
+        while (missing != 0) {
+            size_t row = word * 64 + lowestBit(missing);
+            switch (type) {
+                case ColumnType::Int64: ints[row] = i; break;
+                case ColumnType::Double: doubles[row] = d; break;
+                case ColumnType::Bool: bools[row] = b; break;
+                case ColumnType::Categorical: codes[row] = code; break;
+                default: strings[row] = val; break;
+            }
+            missing &= missing - 1;
+        }
+    }
+    validity.clear();
+    nulls = 0;
+}
+
+std::string Column::get(size_t row) const {
+    if (isNull(row)) {
+        return "";
+    }
+    switch (type) {
+        case ColumnType::Int64: return std::to_string(ints[row]);
+        case ColumnType::Double: return formatDouble(doubles[row], precision);
+        case ColumnType::Bool: return bools[row] ? "true" : "false";
+        case ColumnType::Categorical: return std::string(dictionary[codes[row]]);
+        default: return std::string(strings[row]);
+    }
+}
+
+// Nulls read as zero
+int64_t Column::getInt(size_t row) const {
+    if (isNull(row)) {
+        return 0;
+    }
+    switch (type) {
+        case ColumnType::Int64: return ints[row];
+        case ColumnType::Double: return static_cast<int64_t>(doubles[row]);
+        case ColumnType::Bool: return bools[row];
+        default: {
+            int64_t value;
+            if (!parseInt64(stringAt(row), value)) {
+                throw std::invalid_argument("not an integer: " + std::string(stringAt(row)));
+            }
+            return value;
+        }
+    }
+}
+
+// Nulls read as NaN so they propagate through arithmetic
+double Column::getDouble(size_t row) const {
+    if (isNull(row)) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    switch (type) {
+        case ColumnType::Int64: return static_cast<double>(ints[row]);
+        case ColumnType::Double: return doubles[row];
+        case ColumnType::Bool: return bools[row];
+        default: {
+            double value;
+            if (!parseDouble(stringAt(row), value)) {
+                throw std::invalid_argument("not a number: " + std::string(stringAt(row)));
+            }
+            return value;
+        }
+    }
+}
+
+// Nulls read as false
+bool Column::getBool(size_t row) const {
+    if (isNull(row)) {
+        return false;
+    }
+    switch (type) {
+        case ColumnType::Int64: return ints[row] != 0;
+        case ColumnType::Double: return doubles[row] != 0;
+        case ColumnType::Bool: return bools[row];
+        default: {
+            bool value;
+            if (!parseBool(stringAt(row), value)) {
+                throw std::invalid_argument("not a boolean: " + std::string(stringAt(row)));
+            }
+            return value;
+        }
+    }
+}
+
+void Column::set(size_t row, std::string_view val) {
+    int64_t i;
+    double d;
+    bool b;
+    if (val.empty()) {
+        setNull(row);
+        return;
+    }
+    if (type == ColumnType::Int64 && parseInt64(val, i)) {
+        ints[row] = i;
+    }
+    else if (type == ColumnType::Double && parseDouble(val, d)) {
+        doubles[row] = d;
+    }
+    else if (type == ColumnType::Bool && parseBool(val, b)) {
+        bools[row] = b;
+    }
+    else if (type == ColumnType::Categorical) {
+        codes[row] = encode(val);
+    }
+    else {
+        convertTo(ColumnType::String);
+        strings[row] = storeString(val);
+    }
+    markValid(row);
+}
+
+void Column::setInt(size_t row, int64_t val) {
+    if (type == ColumnType::Int64) {
+        ints[row] = val;
+        markValid(row);
+    }
+    else if (type == ColumnType::Double) {
+        setDouble(row, static_cast<double>(val));
+    }
+    else {
+        set(row, std::to_string(val));
+    }
+}
+
+void Column::setDouble(size_t row, double val) {
+    if (type == ColumnType::Int64) {
+        convertTo(ColumnType::Double);
+    }
+    if (type == ColumnType::Double) {
+        doubles[row] = val;
+        markValid(row);
+    }
+    else {
+        set(row, formatDouble(val));
+    }
+}
+
+const std::vector<int64_t> &Column::intData() const {
+    return ints;
+}
+
+const std::vector<double> &Column::doubleData() const {
+    return doubles;
+}
+
+const std::vector<uint8_t> &Column::boolData() const {
+    return bools;
+}
+
+const std::vector<std::string_view> &Column::stringData() const {
+    return strings;
+}
+
+const std::vector<int32_t> &Column::codeData() const {
+    return codes;
+}
+
+const std::vector<std::string_view> &Column::dictionaryData() const {
+    return dictionary;
+}
+
+// Empty when the column has no nulls
+const std::vector<uint64_t> &Column::validityData() const {
+    return validity;
+}
+
+// Returns -1 when the value is not in the dictionary
+int32_t Column::findCode(std::string_view val) const {
+    auto it = dictionaryIndex.find(val);
+    return it != dictionaryIndex.end() ? it->second : -1;
+}
+
+std::string_view Column::stringAt(size_t row) const {
+    return type == ColumnType::Categorical ? dictionary[codes[row]] : strings[row];
+}
+
+std::string_view Column::storeString(std::string_view val) {
+    if (!buffer) {
+        buffer = std::make_shared<StringBuffer>();
+    }
+    return buffer->store(val);
+}
+
+int32_t Column::encode(std::string_view val) {
+    auto it = dictionaryIndex.find(val);
+    if (it != dictionaryIndex.end()) {
+        return it->second;
+    }
+    int32_t code = static_cast<int32_t>(dictionary.size());
+    std::string_view stored = storeString(val);
+    dictionary.push_back(stored);
+    dictionaryIndex.emplace(stored, code);
+    return code;
+}
+
+// Keeps the bytes behind the other column's string views alive
+void Column::shareOwners(const Column &other) {
+    if (other.buffer && other.buffer != buffer) {
+        addOwner(other.buffer);
+    }
+    for (const auto &owner : other.owners) {
+        addOwner(owner);
+    }
+}
+
+void Column::append(const Column &other) {
+    if (&other == this) {
+        Column copy(other);
+        append(copy);
+        return;
+    }
+    ColumnType target = commonType(type, other.type);
+    if (other.type != target) {
+        Column converted(other);
+        converted.convertTo(target);
+        append(converted);
+        return;
+    }
+    convertTo(target);
+    size_t offset = size();
+    if (target == ColumnType::Categorical) {
+        std::vector<int32_t> remap(other.dictionary.size());
+        for (size_t code = 0; code < other.dictionary.size(); ++code) {
+            remap[code] = encode(other.dictionary[code]);
+        }
+        codes.reserve(codes.size() + other.codes.size());
+        for (int32_t code : other.codes) {
+            codes.push_back(code < 0 ? -1 : remap[code]);
+        }
+    }
+    else {
+        ints.insert(ints.end(), other.ints.begin(), other.ints.end());
+        doubles.insert(doubles.end(), other.doubles.begin(), other.doubles.end());
+        bools.insert(bools.end(), other.bools.begin(), other.bools.end());
+        strings.insert(strings.end(), other.strings.begin(), other.strings.end());
+        if (!other.strings.empty()) {
+            shareOwners(other);
+        }
+    }
+    if (!validity.empty()) {
+        materializeValidity();
+    }
+    if (other.nulls > 0) {
+        for (size_t row = 0; row < other.size(); ++row) {
+            if (other.isNull(row)) {
+                markNull(offset + row);
+            }
+        }
+    }
+}
+
+// Keeps only the rows whose bit is set in mask, which has one bit per row in
+// the layout of the validity bitmap. Rows are compacted in place, in order.
+void Column::compact(const std::vector<uint64_t> &mask) {
+    size_t count = size();
+    if (!validity.empty()) {
+        std::vector<uint64_t> compacted((count + 63) / 64, ~0ULL);
+        size_t out = 0;
+        nulls = 0;
+        for (size_t base = 0; base < count; base += 64) {
+            uint64_t word = mask[base / 64];
+            if (count - base < 64) {
+                word &= (1ULL << (count - base)) - 1;
+            }
+            while (word != 0) {
+                if (isNull(base + lowestBit(word))) {
+                    compacted[out / 64] &= ~(1ULL << (out % 64));
+                    ++nulls;
+                }
+                ++out;
+                word &= word - 1;
+            }
+        }
+        compacted.resize((out + 63) / 64);
+        if (nulls == 0) {
+            compacted.clear();
+        }
+        validity.swap(compacted);
+    }
+    switch (type) {
+        case ColumnType::Int64: compactValues(ints, mask); break;
+        case ColumnType::Double: compactValues(doubles, mask); break;
+        case ColumnType::Bool: compactValues(bools, mask); break;
+        case ColumnType::Categorical: compactValues(codes, mask); break;
+        default: compactValues(strings, mask); break;
+    }
+}
+
+// Validity bitmap of the rows at the given positions, empty when none of them
+// is null
+std::vector<uint64_t> Column::selectValidity(const std::vector<size_t> &indices, size_t &selectedNulls) const {
+    std::vector<uint64_t> selected;
+    selectedNulls = 0;
+    if (validity.empty()) {
+        return selected;
+    }
+    selected.assign((indices.size() + 63) / 64, ~0ULL);
+    for (size_t k = 0; k < indices.size(); ++k) {
+        if (isNull(indices[k])) {
+            selected[k / 64] &= ~(1ULL << (k % 64));
+            ++selectedNulls;
+        }
+    }
+    if (selectedNulls == 0) {
+        selected.clear();
+    }
+    return selected;
+}
+
+// Keeps only the rows at the given positions, in the given order
+void Column::select(const std::vector<size_t> &indices) {
+    switch (type) {
+        case ColumnType::Int64: gather(ints, indices); break;
+        case ColumnType::Double: gather(doubles, indices); break;
+        case ColumnType::Bool: gather(bools, indices); break;
+        case ColumnType::Categorical: gather(codes, indices); break;
+        default: gather(strings, indices); break;
+    }
+    validity = selectValidity(indices, nulls);
+}
+
+// A new column of the same type with only the rows at the given positions, in
+// the given order, sharing the string storage and dictionary of this one
+Column Column::copyRows(const std::vector<size_t> &indices) const {
+    Column result(type);
+    result.precision = precision;
+    switch (type) {
+        case ColumnType::Int64: gather(ints, indices, result.ints); break;
+        case ColumnType::Double: gather(doubles, indices, result.doubles); break;
+        case ColumnType::Bool: gather(bools, indices, result.bools); break;
+        case ColumnType::Categorical:
+            gather(codes, indices, result.codes);
+            result.dictionary = dictionary;
+            result.dictionaryIndex = dictionaryIndex;
+            break;
+        default: gather(strings, indices, result.strings); break;
+    }
+    if (type == ColumnType::String || type == ColumnType::Categorical) {
+        result.buffer = buffer;
+        result.owners = owners;
+    }
+    result.validity = selectValidity(indices, result.nulls);
+    return result;
+}
@@ -0,0 +1,103 @@
+#ifndef COLUMN_HPP
+#define COLUMN_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "StringBuffer.hpp"
+
+enum class ColumnType {
+    Int64,
+    Double,
+    Bool,
+    String,
+    Categorical
+};
+
+// Contiguous storage for a single dataframe column, indexed by row position.
+// Values are kept in the vector matching the column type, the others stay empty.
+// Categorical columns store one integer code per row into a dictionary of the
+// distinct strings.
+// Missing values are tracked in a validity bitmap with one bit per row, set when
+// the value is present. The bitmap stays empty while the column has no nulls and
+// the value slot of a null row holds a placeholder. Empty strings are nulls.
+// String cells are views into bytes kept alive by the column: its own buffer for
+// values written through the column, and shared owners such as a mapped file.
+class Column {
+    friend class DataFile;
+    friend class ArrowData;
+
+private:
+    ColumnType type;
+    int precision;
+    std::vector<int64_t> ints;
+    std::vector<double> doubles;
+    std::vector<uint8_t> bools;
+    std::vector<std::string_view> strings;
+    std::vector<int32_t> codes;
+    std::vector<std::string_view> dictionary;
+    std::unordered_map<std::string_view, int32_t> dictionaryIndex;
+    std::shared_ptr<StringBuffer> buffer;
+    std::vector<std::shared_ptr<const void>> owners;
+    std::vector<uint64_t> validity;
+    size_t nulls;
+    std::string_view stringAt(size_t row) const;
+    std::string_view storeString(std::string_view val);
+    int32_t encode(std::string_view val);
+    void shareOwners(const Column &other);
+    void pushPlaceholder();
+    void materializeValidity();
+    void markNull(size_t row);
+    void markValid(size_t row);
+    std::vector<uint64_t> selectValidity(const std::vector<size_t> &indices, size_t &selectedNulls) const;
+
+public:
+    Column();
+    explicit Column(ColumnType type);
+    Column(size_t size, std::string_view fill);
+    ColumnType getType() const;
+    bool isNumeric() const;
+    size_t size() const;
+    void reserve(size_t n);
+    void clear();
+    void resize(size_t n, std::string_view fill = "");
+    void inferType();
+    void convertTo(ColumnType newType);
+    void setPrecision(int digits);
+    int getPrecision() const;
+    void push_back(std::string_view val);
+    void pushView(std::string_view val);
+    void addOwner(std::shared_ptr<const void> owner);
+    void pushInt(int64_t val);
+    void pushDouble(double val);
+    void pushBool(bool val);
+    void pushNull();
+    bool isNull(size_t row) const;
+    size_t nullCount() const;
+    void setNull(size_t row);
+    void fillNull(std::string_view val);
+    std::string get(size_t row) const;
+    int64_t getInt(size_t row) const;
+    double getDouble(size_t row) const;
+    bool getBool(size_t row) const;
+    void set(size_t row, std::string_view val);
+    void setInt(size_t row, int64_t val);
+    void setDouble(size_t row, double val);
+    const std::vector<int64_t> &intData() const;
+    const std::vector<double> &doubleData() const;
+    const std::vector<uint8_t> &boolData() const;
+    const std::vector<std::string_view> &stringData() const;
+    const std::vector<int32_t> &codeData() const;
+    const std::vector<std::string_view> &dictionaryData() const;
+    const std::vector<uint64_t> &validityData() const;
+    int32_t findCode(std::string_view val) const;
+    void append(const Column &other);
+    void select(const std::vector<size_t> &indices);
+    Column copyRows(const std::vector<size_t> &indices) const;
+    void compact(const std::vector<uint64_t> &mask);
+};
+
+#endif  // COLUMN_HPP
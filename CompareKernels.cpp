@@ -0,0 +1,254 @@
+#include "CompareKernels.hpp"
+#include "utils.hpp"
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CMP_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CMP_SSE2
+#endif
+
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+// Integers are tested against the range [low, high], the result flipped when
+// inverted. An empty range has low > high.
+struct IntRange {
+    int64_t low;
+    int64_t high;
+    bool inverted;
+};
+
+typedef void (*DoubleKernel)(const double *values, size_t blocks, PredicateOp op, double constant, uint64_t *mask);
+typedef void (*IntKernel)(const int64_t *values, size_t blocks, IntRange range, uint64_t *mask);
+
+template<typename Compare>
+static uint64_t scalarWord(const double *values, size_t count, Compare compare) {
+    uint64_t word = 0;
+    for (size_t i = 0; i < count; ++i) {
+        word |= static_cast<uint64_t>(compare(values[i])) << i;
+    }
+    return word;
+}
+
+static uint64_t scalarWord(const double *values, size_t count, PredicateOp op, double c) {
+    switch (op) {
+        case PredicateOp::Equal: return scalarWord(values, count, [c](double v) { return v == c; });
+        case PredicateOp::NotEqual: return scalarWord(values, count, [c](double v) { return v != c; });
+        case PredicateOp::Less: return scalarWord(values, count, [c](double v) { return v < c; });
+        case PredicateOp::LessEqual: return scalarWord(values, count, [c](double v) { return v <= c; });
+        case PredicateOp::Greater: return scalarWord(values, count, [c](double v) { return v > c; });
+        default: return scalarWord(values, count, [c](double v) { return v >= c; });
+    }
+}
+
+static uint64_t scalarWord(const int64_t *values, size_t count, IntRange range) {
+    uint64_t word = 0;
+    for (size_t i = 0; i < count; ++i) {
+        bool inside = values[i] >= range.low && values[i] <= range.high;
+        word |= static_cast<uint64_t>(inside != range.inverted) << i;
+    }
+    return word;
+}
+
+#ifndef CMP_SSE2
+static void scalarDoubles(const double *values, size_t blocks, PredicateOp op, double constant, uint64_t *mask) {
+    for (size_t b = 0; b < blocks; ++b) {
+        mask[b] = scalarWord(values + b * 64, 64, op, constant);
+    }
+}
+#endif
+
+static void scalarInts(const int64_t *values, size_t blocks, IntRange range, uint64_t *mask) {
+    for (size_t b = 0; b < blocks; ++b) {
+        mask[b] = scalarWord(values + b * 64, 64, range);
+    }
+}
+
+#ifdef CMP_SSE2
+template<typename Compare>
+static void sse2Doubles(const double *values, size_t blocks, double constant, uint64_t *mask, Compare compare) {
+    const __m128d c = _mm_set1_pd(constant);
+    for (size_t b = 0; b < blocks; ++b) {
+        const double *p = values + b * 64;
+        uint64_t word = 0;
+        for (int i = 0; i < 64; i += 2) {
+            word |= static_cast<uint64_t>(_mm_movemask_pd(compare(_mm_loadu_pd(p + i), c))) << i;
+        }
+        mask[b] = word;
+    }
+}
+
+static void sse2Doubles(const double *values, size_t blocks, PredicateOp op, double constant, uint64_t *mask) {
+    switch (op) {
+        case PredicateOp::Equal: return sse2Doubles(values, blocks, constant, mask, [](__m128d v, __m128d c) { return _mm_cmpeq_pd(v, c); });
+        case PredicateOp::NotEqual: return sse2Doubles(values, blocks, constant, mask, [](__m128d v, __m128d c) { return _mm_cmpneq_pd(v, c); });
+        case PredicateOp::Less: return sse2Doubles(values, blocks, constant, mask, [](__m128d v, __m128d c) { return _mm_cmplt_pd(v, c); });
+        case PredicateOp::LessEqual: return sse2Doubles(values, blocks, constant, mask, [](__m128d v, __m128d c) { return _mm_cmple_pd(v, c); });
+        case PredicateOp::Greater: return sse2Doubles(values, blocks, constant, mask, [](__m128d v, __m128d c) { return _mm_cmpgt_pd(v, c); });
+        default: return sse2Doubles(values, blocks, constant, mask, [](__m128d v, __m128d c) { return _mm_cmpge_pd(v, c); });
+    }
+}
+#endif
+
+#ifdef CMP_X86
+// The comparison predicate of _mm256_cmp_pd must be a constant. The ordered
+// forms are false on NaN, != is unordered so NaN passes, as in scalar code.
+template<int Predicate>
+TARGET_AVX2 static void avx2Doubles(const double *values, size_t blocks, double constant, uint64_t *mask) {
+    const __m256d c = _mm256_set1_pd(constant);
+    for (size_t b = 0; b < blocks; ++b) {
+        const double *p = values + b * 64;
+        uint64_t word = 0;
+        for (int i = 0; i < 64; i += 4) {
+            __m256d v = _mm256_loadu_pd(p + i);
+            word |= static_cast<uint64_t>(_mm256_movemask_pd(_mm256_cmp_pd(v, c, Predicate))) << i;
+        }
+        mask[b] = word;
+    }
+}
+
+TARGET_AVX2 static void avx2Doubles(const double *values, size_t blocks, PredicateOp op, double constant, uint64_t *mask) {
+    switch (op) {
+        case PredicateOp::Equal: return avx2Doubles<_CMP_EQ_OQ>(values, blocks, constant, mask);
+        case PredicateOp::NotEqual: return avx2Doubles<_CMP_NEQ_UQ>(values, blocks, constant, mask);
+        case PredicateOp::Less: return avx2Doubles<_CMP_LT_OQ>(values, blocks, constant, mask);
+        case PredicateOp::LessEqual: return avx2Doubles<_CMP_LE_OQ>(values, blocks, constant, mask);
+        case PredicateOp::Greater: return avx2Doubles<_CMP_GT_OQ>(values, blocks, constant, mask);
+        default: return avx2Doubles<_CMP_GE_OQ>(values, blocks, constant, mask);
+    }
+}
+
+TARGET_AVX2 static void avx2Ints(const int64_t *values, size_t blocks, IntRange range, uint64_t *mask) {
+    const __m256i low = _mm256_set1_epi64x(range.low);
+    const __m256i high = _mm256_set1_epi64x(range.high);
+    const uint64_t flip = range.inverted ? ~0ULL : 0;
+    for (size_t b = 0; b < blocks; ++b) {
+        const int64_t *p = values + b * 64;
+        uint64_t outside = 0;
+        for (int i = 0; i < 64; i += 4) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+            __m256i out = _mm256_or_si256(_mm256_cmpgt_epi64(low, v), _mm256_cmpgt_epi64(v, high));
+            outside |= static_cast<uint64_t>(_mm256_movemask_pd(_mm256_castsi256_pd(out))) << i;
+        }
+        mask[b] = ~outside ^ flip;
+    }
+}
+#endif
+
+static DoubleKernel selectDoubleKernel() {
+#ifdef CMP_X86
+    if (cpuHasAVX2()) {
+        return avx2Doubles;
+    }
+#endif
+#ifdef CMP_SSE2
+    return sse2Doubles;
+#else
+    return scalarDoubles;
+#endif
+}
+
+static IntKernel selectIntKernel() {
+#ifdef CMP_X86
+    if (cpuHasAVX2()) {
+        return avx2Ints;
+    }
+#endif
+    return scalarInts;
+}
+
+static const DoubleKernel doubleKernel = selectDoubleKernel();
+static const IntKernel intKernel = selectIntKernel();
+
+void compareDoubles(const double *values, size_t count, PredicateOp op, double constant, uint64_t *mask) {
+    size_t blocks = count / 64;
+    doubleKernel(values, blocks, op, constant, mask);
+    if (count % 64 != 0) {
+        mask[blocks] = scalarWord(values + blocks * 64, count % 64, op, constant);
+    }
+}
+
+// Smallest integer whose double value is above the constant (or at least the
+// constant when not strict), false when there is none. The test is monotone in
+// the integer, so a binary search finds the exact boundary.
+static bool firstAbove(double constant, bool strict, int64_t &first) {
+    auto passes = [&](int64_t v) {
+        double d = static_cast<double>(v);
+        return strict ? d > constant : d >= constant;
+    };
+    int64_t low = std::numeric_limits<int64_t>::min();
+    int64_t high = std::numeric_limits<int64_t>::max();
+    if (!passes(high)) {
+        return false;
+    }
+    while (low < high) {
+        int64_t mid = low + static_cast<int64_t>((static_cast<uint64_t>(high) - static_cast<uint64_t>(low)) / 2);
+        if (passes(mid)) {
+            high = mid;
+        }
+        else {
+            low = mid + 1;
+        }
+    }
+    first = low;
+    return true;
+}
+
+// Turns "static_cast<double>(v) op constant" into an exact integer range test
+static IntRange intRange(PredicateOp op, double constant) {
+    const int64_t min = std::numeric_limits<int64_t>::min();
+    const int64_t max = std::numeric_limits<int64_t>::max();
+    const IntRange none{1, 0, false};
+    if (std::isnan(constant)) {
+        return op == PredicateOp::NotEqual ? IntRange{1, 0, true} : none;
+    }
+    int64_t atLeast;
+    int64_t above;
+    bool hasAtLeast = firstAbove(constant, false, atLeast);
+    bool hasAbove = firstAbove(constant, true, above);
+    IntRange greaterEqual = hasAtLeast ? IntRange{atLeast, max, false} : none;
+    IntRange greater = hasAbove ? IntRange{above, max, false} : none;
+    IntRange equal = none;
+    if (hasAtLeast && (!hasAbove || above > min)) {
+        equal = IntRange{atLeast, hasAbove ? above - 1 : max, false};
+    }
+    switch (op) {
+        case PredicateOp::Equal: return equal;
+        case PredicateOp::NotEqual: return IntRange{equal.low, equal.high, true};
+        case PredicateOp::Less: return IntRange{greaterEqual.low, greaterEqual.high, true};
+        case PredicateOp::LessEqual: return IntRange{greater.low, greater.high, true};
+        case PredicateOp::Greater: return greater;
+        default: return greaterEqual;
+    }
+}
+
+void compareInts(const int64_t *values, size_t count, PredicateOp op, double constant, uint64_t *mask) {
+    IntRange range = intRange(op, constant);
+    size_t blocks = count / 64;
+    intKernel(values, blocks, range, mask);
+    if (count % 64 != 0) {
+        mask[blocks] = scalarWord(values + blocks * 64, count % 64, range);
+    }
+}
+
+void appendSelection(const uint64_t *mask, size_t count, std::vector<size_t> &selection) {
+    size_t words = (count + 63) / 64;
+    for (size_t w = 0; w < words; ++w) {
+        uint64_t word = mask[w];
+        if (w == words - 1 && count % 64 != 0) {
+            word &= (1ULL << (count % 64)) - 1;
+        }
+        while (word != 0) {
+            selection.push_back(w * 64 + lowestBit(word));
+            word &= word - 1;
+        }
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef COMPAREKERNELS_HPP
+#define COMPAREKERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Predicate.hpp"
+
+
+// Compare a typed column with a constant and set bit i of mask (bit i % 64 of
+// word i / 64, the layout of the column validity bitmap) when value i passes.
+// The op is one of ==, !=, <, <=, >, >=, with the results of the scalar
+// double comparison. The AVX2 kernels are chosen at runtime when the CPU has
+// them, doubles fall back to SSE2 and then to scalar code.
+// mask must hold (count + 63) / 64 words, bits past count are cleared.
+void compareDoubles(const double *values, size_t count, PredicateOp op, double constant, uint64_t *mask);
+void compareInts(const int64_t *values, size_t count, PredicateOp op, double constant, uint64_t *mask);
+
+// Appends the positions of the set bits of mask below count to selection
+void appendSelection(const uint64_t *mask, size_t count, std::vector<size_t> &selection);
+
+#endif  // COMPAREKERNELS_HPP
@@ -0,0 +1,273 @@
+#include "DataFile.hpp"
+#include "CSVReader.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static const char MAGIC[8] = {'C', 'P', 'P', 'D', 'F', 'B', 'I', 'N'};
+static const uint32_t VERSION = 1;
+static const uint32_t ENDIAN_MARK = 0x01020304;
+
+static uint64_t alignUp(uint64_t n) {
+    return (n + 7) & ~uint64_t(7);
+}
+
+static uint64_t wordCount(uint64_t rows) {
+    return (rows + 63) / 64;
+}
+
+// Size of the data section of a column, laid out as written by writeSection
+static uint64_t sectionSize(const Column &column, uint64_t rows) {
+    uint64_t size = column.nullCount() > 0 ? wordCount(rows) * 8 : 0;
+    switch (column.getType()) {
+        case ColumnType::Int64:
+        case ColumnType::Double:
+            return size + rows * 8;
+        case ColumnType::Bool:
+            return size + alignUp(rows);
+        case ColumnType::Categorical: {
+            uint64_t bytes = 0;
+            for (std::string_view value : column.dictionaryData()) {
+                bytes += value.size();
+            }
+            uint64_t dictSize = column.dictionaryData().size();
+            return size + 8 + (dictSize + 1) * 8 + alignUp(bytes) + alignUp(rows * 4);
+        }
+        default: {
+            uint64_t bytes = 0;
+            for (std::string_view value : column.stringData()) {
+                bytes += value.size();
+            }
+            return size + (rows + 1) * 8 + alignUp(bytes);
+        }
+    }
+}
+
+static void writeValue(std::ofstream &out, uint64_t value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void writePadding(std::ofstream &out, uint64_t written) {
+    static const char zeros[8] = {};
+    out.write(zeros, alignUp(written) - written);
+}
+
+// Offsets then the concatenated bytes of a list of strings
+static void writeStrings(std::ofstream &out, const std::vector<std::string_view> &values) {
+    uint64_t offset = 0;
+    writeValue(out, offset);
+    for (std::string_view value : values) {
+        offset += value.size();
+        writeValue(out, offset);
+    }
+    for (std::string_view value : values) {
+        out.write(value.data(), value.size());
+    }
+    writePadding(out, offset);
+}
+
+static void writeSection(std::ofstream &out, const Column &column, uint64_t rows) {
+    if (column.nullCount() > 0) {
+        const std::vector<uint64_t> &validity = column.validityData();
+        for (uint64_t w = 0; w < wordCount(rows); ++w) {
+            writeValue(out, w < validity.size() ? validity[w] : ~0ULL);
+        }
+    }
+    switch (column.getType()) {
+        case ColumnType::Int64:
+            out.write(reinterpret_cast<const char *>(column.intData().data()), rows * 8);
+            break;
+        case ColumnType::Double:
+            out.write(reinterpret_cast<const char *>(column.doubleData().data()), rows * 8);
+            break;
+        case ColumnType::Bool:
+            out.write(reinterpret_cast<const char *>(column.boolData().data()), rows);
+            writePadding(out, rows);
+            break;
+        case ColumnType::Categorical:
+            writeValue(out, column.dictionaryData().size());
+            writeStrings(out, column.dictionaryData());
+            out.write(reinterpret_cast<const char *>(column.codeData().data()), rows * 4);
+            writePadding(out, rows * 4);
+            break;
+        default:
+            writeStrings(out, column.stringData());
+            break;
+    }
+}
+
+bool DataFile::save(const std::string &path, const std::vector<std::string> &headers,
+    const std::vector<Column> &columns, size_t rowCount) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        return false;
+    }
+    out.write(MAGIC, sizeof(MAGIC));
+    out.write(reinterpret_cast<const char *>(&VERSION), sizeof(VERSION));
+    out.write(reinterpret_cast<const char *>(&ENDIAN_MARK), sizeof(ENDIAN_MARK));
+    writeValue(out, rowCount);
+    writeValue(out, columns.size());
+
+    uint64_t offset = 32;
+    for (const auto &header : headers) {
+        offset += 8 + alignUp(header.size()) + 32;
+    }
+    for (size_t col = 0; col < columns.size(); ++col) {
+        const Column &column = columns[col];
+        writeValue(out, headers[col].size());
+        out.write(headers[col].data(), headers[col].size());
+        writePadding(out, headers[col].size());
+        uint32_t type = static_cast<uint32_t>(column.getType());
+        int32_t precision = column.getPrecision();
+        out.write(reinterpret_cast<const char *>(&type), sizeof(type));
+        out.write(reinterpret_cast<const char *>(&precision), sizeof(precision));
+        writeValue(out, column.nullCount());
+        uint64_t size = sectionSize(column, rowCount);
+        writeValue(out, offset);
+        writeValue(out, size);
+        offset += size;
+    }
+    for (const auto &column : columns) {
+        writeSection(out, column, rowCount);
+    }
+    return static_cast<bool>(out);
+}
+
+// Bounds-checked reads from the mapping, any inconsistency means a damaged file
+class SectionReader {
+private:
+    const char *begin;
+    const char *end;
+    const char *p;
+    const std::string &path;
+
+public:
+    SectionReader(const char *begin, const char *end, const std::string &path)
+    : begin(begin), end(end), p(begin), path(path) {
+        //
+    }
+
+    const char *take(uint64_t bytes) {
+        if (bytes > static_cast<uint64_t>(end - p)) {
+            throw std::runtime_error("invalid data file: " + path);
+        }
+        const char *data = p;
+        p += bytes;
+        return data;
+    }
+
+    // Skips the padding after a block, which may be missing at the very end
+    void align() {
+        p = begin + std::min<uint64_t>(alignUp(p - begin), end - begin);
+    }
+
+    uint64_t value() {
+        uint64_t v;
+        std::memcpy(&v, take(8), 8);
+        return v;
+    }
+
+    template<typename T>
+    void copyTo(std::vector<T> &values, uint64_t count) {
+        if (count > static_cast<uint64_t>(end - p) / sizeof(T)) {
+            throw std::runtime_error("invalid data file: " + path);
+        }
+        values.resize(count);
+        std::memcpy(values.data(), take(count * sizeof(T)), count * sizeof(T));
+        align();
+    }
+
+    // Views into the mapping for a block written by writeStrings
+    void stringsTo(std::vector<std::string_view> &values, uint64_t count) {
+        std::vector<uint64_t> offsets;
+        copyTo(offsets, count + 1);
+        const char *data = take(offsets[count]);
+        align();
+        values.resize(count);
+        for (uint64_t i = 0; i < count; ++i) {
+            if (offsets[i] > offsets[i + 1] || offsets[i + 1] > offsets[count]) {
+                throw std::runtime_error("invalid data file: " + path);
+            }
+            values[i] = std::string_view(data + offsets[i], offsets[i + 1] - offsets[i]);
+        }
+    }
+};
+
+void DataFile::open(const std::string &path, std::vector<std::string> &headers,
+    std::vector<Column> &columns, size_t &rowCount) {
+    auto file = std::make_shared<MappedFile>(path);
+    SectionReader header(file->data(), file->data() + file->size(), path);
+    const char *magic = header.take(sizeof(MAGIC));
+    uint32_t version;
+    uint32_t byteOrder;
+    std::memcpy(&version, header.take(4), 4);
+    std::memcpy(&byteOrder, header.take(4), 4);
+    if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION || byteOrder != ENDIAN_MARK) {
+        throw std::runtime_error("invalid data file: " + path);
+    }
+    uint64_t rows = header.value();
+    uint64_t columnCount = header.value();
+
+    headers.clear();
+    columns.clear();
+    for (uint64_t col = 0; col < columnCount; ++col) {
+        uint64_t nameLength = header.value();
+        headers.emplace_back(header.take(nameLength), nameLength);
+        header.align();
+        uint32_t type;
+        int32_t precision;
+        std::memcpy(&type, header.take(4), 4);
+        std::memcpy(&precision, header.take(4), 4);
+        uint64_t nulls = header.value();
+        uint64_t offset = header.value();
+        uint64_t size = header.value();
+        if (type > static_cast<uint32_t>(ColumnType::Categorical) || offset > file->size() || size > file->size() - offset) {
+            throw std::runtime_error("invalid data file: " + path);
+        }
+
+        Column column(static_cast<ColumnType>(type));
+        column.precision = precision;
+        SectionReader section(file->data() + offset, file->data() + offset + size, path);
+        if (nulls > 0) {
+            section.copyTo(column.validity, wordCount(rows));
+            if (rows % 64 != 0) {
+                column.validity.back() |= ~0ULL << (rows % 64);
+            }
+            column.nulls = 0;
+            for (uint64_t word : column.validity) {
+                column.nulls += popCount(~word);
+            }
+            if (column.nulls != nulls) {
+                throw std::runtime_error("invalid data file: " + path);
+            }
+        }
+        switch (column.type) {
+            case ColumnType::Int64: section.copyTo(column.ints, rows); break;
+            case ColumnType::Double: section.copyTo(column.doubles, rows); break;
+            case ColumnType::Bool: section.copyTo(column.bools, rows); break;
+            case ColumnType::Categorical: {
+                uint64_t dictSize = section.value();
+                section.stringsTo(column.dictionary, dictSize);
+                for (size_t code = 0; code < column.dictionary.size(); ++code) {
+                    column.dictionaryIndex.emplace(column.dictionary[code], static_cast<int32_t>(code));
+                }
+                section.copyTo(column.codes, rows);
+                for (size_t row = 0; row < column.codes.size(); ++row) {
+                    int32_t code = column.codes[row];
+                    if (code < 0 ? code != -1 || !column.isNull(row) : code >= static_cast<int64_t>(dictSize)) {
+                        throw std::runtime_error("invalid data file: " + path);
+                    }
+                }
+                break;
+            }
+            default:
+                section.stringsTo(column.strings, rows);
+                break;
+        }
+        column.addOwner(file);
+        columns.push_back(std::move(column));
+    }
+    rowCount = rows;
+}
@@ -0,0 +1,27 @@
+#ifndef DATAFILE_HPP
+#define DATAFILE_HPP
+
+#include <string>
+#include <vector>
+#include "Column.hpp"
+
+
+// Binary columnar file format, saved and reopened by Dataframe::save and
+// Dataframe::open. The file starts with a schema header: magic, version, a
+// byte order mark, the row and column counts, then one directory entry per
+// column with its name, type, precision, null count and the offset and size of
+// its data section. Sections are 8-byte aligned and hold the validity bitmap
+// when the column has nulls, then the typed values. Strings are stored as
+// offsets plus one data block, categorical columns as a dictionary in the same
+// layout plus one code per row.
+// Opened files are memory-mapped: string and dictionary cells stay views into
+// the mapping, fixed-width buffers are copied in bulk.
+class DataFile {
+public:
+    static bool save(const std::string &path, const std::vector<std::string> &headers,
+        const std::vector<Column> &columns, size_t rowCount);
+    static void open(const std::string &path, std::vector<std::string> &headers,
+        std::vector<Column> &columns, size_t &rowCount);
+};
+
+#endif  // DATAFILE_HPP
@@ -0,0 +1,74 @@
+#include "DataframeView.hpp"
+#include "CompareKernels.hpp"
+
+template DataframeView &DataframeView::filterRows<std::string>(const std::string &colName, const std::string &op, std::string value);
+template DataframeView &DataframeView::filterRows<double>(const std::string &colName, const std::string &op, double value);
+
+DataframeView::DataframeView(Dataframe &df)
+: df(df), mask((df.rowCount + 63) / 64, ~0ULL), rowCount(df.rowCount) {
+    //
+}
+
+// Narrows the selection to the rows also passing the passed mask
+void DataframeView::narrow(const std::vector<uint64_t> &passed) {
+    rowCount = 0;
+    for (size_t w = 0; w < mask.size(); ++w) {
+        mask[w] &= passed[w];
+        if (w == mask.size() - 1 && df.rowCount % 64 != 0) {
+            mask[w] &= (1ULL << (df.rowCount % 64)) - 1;
+        }
+        rowCount += popCount(mask[w]);
+    }
+}
+
+template<typename T>
+DataframeView &DataframeView::filterRows(const std::string &colName, const std::string &op, T value) {
+    std::vector<uint64_t> passed;
+    df.evaluateFilter(Predicate(colName, op, value), passed);
+    narrow(passed);
+    return *this;
+}
+
+DataframeView &DataframeView::filter(const FilterExpression &expression) {
+    std::vector<uint64_t> passed;
+    expression.evaluate(df.headers, df.columns, df.rowCount, passed);
+    narrow(passed);
+    return *this;
+}
+
+size_t DataframeView::getRowCount() const {
+    return rowCount;
+}
+
+// Positions of the selected rows in the dataframe
+std::vector<size_t> DataframeView::getRowIndices() const {
+    std::vector<size_t> indices;
+    indices.reserve(rowCount);
+    appendSelection(mask.data(), df.rowCount, indices);
+    return indices;
+}
+
+std::vector<std::string> DataframeView::getColumn(const std::string &colName) {
+    const Column &column = df.getColumnData(colName);
+    std::vector<std::string> values;
+    values.reserve(rowCount);
+    for (size_t row : getRowIndices()) {
+        values.push_back(column.get(row));
+    }
+    return values;
+}
+
+// Copies the selected rows into a new dataframe, gathering only those rows
+Dataframe DataframeView::materialize() const {
+    std::vector<size_t> indices = getRowIndices();
+    Dataframe result;
+    result.isReplacingNulls = df.isReplacingNulls;
+    result.nullReplacement = df.nullReplacement;
+    result.rowCount = indices.size();
+    result.headers = df.headers;
+    result.columns.reserve(df.columns.size());
+    for (const Column &column : df.columns) {
+        result.columns.push_back(column.copyRows(indices));
+    }
+    return result;
+}
@@ -0,0 +1,29 @@
+#ifndef DATAFRAMEVIEW_HPP
+#define DATAFRAMEVIEW_HPP
+
+#include <string>
+#include <vector>
+#include "dataframe.hpp"
+
+
+// A lazy selection of the rows of a dataframe. Filters only update a bitmask,
+// with one bit per row of the dataframe, and nothing is copied until the view
+// is materialized. The dataframe must outlive the view and stay unchanged.
+class DataframeView {
+private:
+    Dataframe &df;
+    std::vector<uint64_t> mask;
+    size_t rowCount;
+    void narrow(const std::vector<uint64_t> &passed);
+
+public:
+    explicit DataframeView(Dataframe &df);
+    template<typename T> DataframeView &filterRows(const std::string &colName, const std::string &op, T value);
+    DataframeView &filter(const FilterExpression &expression);
+    size_t getRowCount() const;
+    std::vector<size_t> getRowIndices() const;
+    std::vector<std::string> getColumn(const std::string &colName);
+    Dataframe materialize() const;
+};
+
+#endif  // DATAFRAMEVIEW_HPP
@@ -0,0 +1,446 @@
+#include "Expression.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <stdexcept>
+
+// Rows evaluated per block, so the intermediate buffers stay in cache
+static const size_t BLOCK_ROWS = 1024;
+static const size_t BLOCK_WORDS = BLOCK_ROWS / 64;
+
+// Recursive descent over the grammar
+//     sum     := product (('+' | '-') product)*
+//     product := unary (('*' | '/') unary)*
+//     unary   := '-' unary | primary
+//     primary := number | name | '`' text '`' | '(' sum ')'
+class ExpressionParser {
+private:
+    const std::string &text;
+    size_t pos;
+
+    [[noreturn]] void fail(const std::string &reason) const {
+        throw std::invalid_argument("invalid expression '" + text + "': " + reason + " at position " + std::to_string(pos));
+    }
+
+    void skipSpaces() {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+            ++pos;
+        }
+    }
+
+    bool accept(char c) {
+        skipSpaces();
+        if (pos < text.size() && text[pos] == c) {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    static std::unique_ptr<ExpressionNode> makeNode(ExpressionOp op, std::unique_ptr<ExpressionNode> left = nullptr,
+        std::unique_ptr<ExpressionNode> right = nullptr) {
+        std::unique_ptr<ExpressionNode> node(new ExpressionNode{op, 0., false, "", std::move(left), std::move(right)});
+        return node;
+    }
+
+    std::unique_ptr<ExpressionNode> parseNumber() {
+        size_t start = pos;
+        bool isInteger = true;
+        while (pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos]))) {
+            ++pos;
+        }
+        if (pos < text.size() && text[pos] == '.') {
+            isInteger = false;
+            ++pos;
+            while (pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos]))) {
+                ++pos;
+            }
+        }
+        if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+            isInteger = false;
+            ++pos;
+            if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) {
+                ++pos;
+            }
+            while (pos < text.size() && std::isdigit(static_cast<unsigned char>(text[pos]))) {
+                ++pos;
+            }
+        }
+        auto node = makeNode(ExpressionOp::Number);
+        int64_t integer;
+        std::string_view token(text.data() + start, pos - start);
+        if (!parseDouble(token, node->number)) {
+            fail("bad number");
+        }
+        // Integers too large for int64 are kept as doubles
+        node->isInteger = isInteger && parseInt64(token, integer);
+        return node;
+    }
+
+    std::unique_ptr<ExpressionNode> parsePrimary() {
+        skipSpaces();
+        if (pos >= text.size()) {
+            fail("unexpected end");
+        }
+        char c = text[pos];
+        if (accept('(')) {
+            auto node = parseSum();
+            if (!accept(')')) {
+                fail("expected ')'");
+            }
+            return node;
+        }
+        if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+            return parseNumber();
+        }
+        auto node = makeNode(ExpressionOp::Column);
+        if (c == '`') {
+            size_t close = text.find('`', pos + 1);
+            if (close == std::string::npos) {
+                fail("unterminated column name");
+            }
+            node->column = text.substr(pos + 1, close - pos - 1);
+            pos = close + 1;
+            return node;
+        }
+        if (!std::isalpha(static_cast<unsigned char>(c)) && c != '_') {
+            fail(std::string("unexpected '") + c + "'");
+        }
+        size_t start = pos;
+        while (pos < text.size() && (std::isalnum(static_cast<unsigned char>(text[pos])) || text[pos] == '_')) {
+            ++pos;
+        }
+        node->column = text.substr(start, pos - start);
+        return node;
+    }
+
+    std::unique_ptr<ExpressionNode> parseUnary() {
+        if (accept('-')) {
+            return makeNode(ExpressionOp::Negate, parseUnary());
+        }
+        return parsePrimary();
+    }
+
+    std::unique_ptr<ExpressionNode> parseProduct() {
+        auto node = parseUnary();
+        while (true) {
+            if (accept('*')) {
+                node = makeNode(ExpressionOp::Multiply, std::move(node), parseUnary());
+            }
+            else if (accept('/')) {
+                node = makeNode(ExpressionOp::Divide, std::move(node), parseUnary());
+            }
+            else {
+                return node;
+            }
+        }
+    }
+
+    std::unique_ptr<ExpressionNode> parseSum() {
+        auto node = parseProduct();
+        while (true) {
+            if (accept('+')) {
+                node = makeNode(ExpressionOp::Add, std::move(node), parseProduct());
+            }
+            else if (accept('-')) {
+                node = makeNode(ExpressionOp::Subtract, std::move(node), parseProduct());
+            }
+            else {
+                return node;
+            }
+        }
+    }
+
+public:
+    explicit ExpressionParser(const std::string &text)
+    : text(text), pos(0) {
+        //
+    }
+
+    std::unique_ptr<ExpressionNode> parse() {
+        auto node = parseSum();
+        skipSpaces();
+        if (pos < text.size()) {
+            fail(std::string("unexpected '") + text[pos] + "'");
+        }
+        return node;
+    }
+};
+
+Expression::Expression(const std::string &text)
+: text(text), root(ExpressionParser(text).parse()) {
+    //
+}
+
+const std::string &Expression::getText() const {
+    return text;
+}
+
+// Values of one node for the current block: a constant, or count values with
+// a validity word per 64 rows (no words when every row is valid)
+template<typename T>
+struct BlockValues {
+    bool isScalar;
+    T scalar;
+    const T *values;
+    const uint64_t *valid;
+};
+
+// An expression node resolved against the columns, with the buffers its
+// results are computed into
+template<typename T>
+struct ExpressionPlan {
+    ExpressionOp op;
+    T number;
+    const Column *column;
+    std::vector<ExpressionPlan> children;
+    std::vector<T> values;
+    std::vector<uint64_t> valid;
+    // Set when an integer result overflows in a valid row
+    bool overflowed = false;
+
+    ExpressionPlan(const ExpressionNode &node, const std::vector<std::string> &headers, const std::vector<Column> &columns)
+    : op(node.op), number(static_cast<T>(node.number)), column(nullptr) {
+        if (node.op == ExpressionOp::Column) {
+            auto it = std::find(headers.begin(), headers.end(), node.column);
+            if (it == headers.end()) {
+                throw std::out_of_range("column not found: " + node.column);
+            }
+            column = &columns[it - headers.begin()];
+        }
+        for (const ExpressionNode *child : {node.left.get(), node.right.get()}) {
+            if (child) {
+                children.emplace_back(*child, headers, columns);
+            }
+        }
+        if (op != ExpressionOp::Number) {
+            values.resize(BLOCK_ROWS);
+            valid.resize(BLOCK_WORDS);
+        }
+    }
+
+    // Column cells of rows [begin, begin + count), typed buffers of the
+    // evaluated type are read in place
+    BlockValues<T> readColumn(size_t begin, size_t count) {
+        const uint64_t *validity = column->nullCount() > 0 ? column->validityData().data() + begin / 64 : nullptr;
+        if (std::is_same<T, double>::value && column->getType() == ColumnType::Double) {
+            return {false, 0, reinterpret_cast<const T *>(column->doubleData().data()) + begin, validity};
+        }
+        if (std::is_same<T, int64_t>::value && column->getType() == ColumnType::Int64) {
+            return {false, 0, reinterpret_cast<const T *>(column->intData().data()) + begin, validity};
+        }
+        switch (column->getType()) {
+            case ColumnType::Int64:
+                std::transform(column->intData().begin() + begin, column->intData().begin() + begin + count,
+                    values.begin(), [](int64_t v) { return static_cast<T>(v); });
+                break;
+            case ColumnType::Bool:
+                std::transform(column->boolData().begin() + begin, column->boolData().begin() + begin + count,
+                    values.begin(), [](uint8_t v) { return static_cast<T>(v); });
+                break;
+            default:
+                // Text cells must hold numbers, as with getDouble
+                for (size_t i = 0; i < count; ++i) {
+                    values[i] = column->isNull(begin + i) ? T() : static_cast<T>(column->getDouble(begin + i));
+                }
+                break;
+        }
+        return {false, 0, values.data(), validity};
+    }
+
+    // Validity of a binary result, null when either side is
+    const uint64_t *combineValid(const BlockValues<T> &a, const BlockValues<T> &b, size_t count) {
+        const uint64_t *first = a.isScalar ? nullptr : a.valid;
+        const uint64_t *second = b.isScalar ? nullptr : b.valid;
+        if (!first || !second) {
+            return first ? first : second;
+        }
+        for (size_t w = 0; w < (count + 63) / 64; ++w) {
+            valid[w] = first[w] & second[w];
+        }
+        return valid.data();
+    }
+
+    // Integer ops OR into flags a value that is negative when they overflow,
+    // which keeps the loops free of branches. Null rows hold placeholders, so
+    // an overflow in a block with nulls is checked again row by row.
+    template<typename Op>
+    BlockValues<T> apply(const BlockValues<T> &a, const BlockValues<T> &b, size_t count, Op op) {
+        T flags = T();
+        if (a.isScalar && b.isScalar) {
+            T result = op(a.scalar, b.scalar, flags);
+            overflowed = overflowed || flags < 0;
+            return {true, result, nullptr, nullptr};
+        }
+        T *out = values.data();
+        if (a.isScalar) {
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = op(a.scalar, b.values[i], flags);
+            }
+        }
+        else if (b.isScalar) {
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = op(a.values[i], b.scalar, flags);
+            }
+        }
+        else {
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = op(a.values[i], b.values[i], flags);
+            }
+        }
+        const uint64_t *resultValid = combineValid(a, b, count);
+        if (std::is_integral<T>::value && flags < 0) {
+            if (!resultValid) {
+                overflowed = true;
+            }
+            for (size_t i = 0; i < count && resultValid && !overflowed; ++i) {
+                T rowFlags = T();
+                op(a.isScalar ? a.scalar : a.values[i], b.isScalar ? b.scalar : b.values[i], rowFlags);
+                overflowed = ((resultValid[i / 64] >> (i % 64)) & 1) && rowFlags < 0;
+            }
+        }
+        return {false, 0, out, resultValid};
+    }
+
+    // Integers wrap around instead of being undefined
+    static T add(T a, T b, T &flags) {
+        if constexpr (std::is_integral<T>::value) {
+            T sum = static_cast<T>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+            flags |= (a ^ sum) & (b ^ sum);
+            return sum;
+        }
+        else {
+            return a + b;
+        }
+    }
+
+    static T subtract(T a, T b, T &flags) {
+        if constexpr (std::is_integral<T>::value) {
+            T difference = static_cast<T>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b));
+            flags |= (a ^ b) & (a ^ difference);
+            return difference;
+        }
+        else {
+            return a - b;
+        }
+    }
+
+    static T multiply(T a, T b, T &flags) {
+        if constexpr (std::is_integral<T>::value) {
+#if defined(__GNUC__)
+            T product;
+            bool overflow = __builtin_mul_overflow(a, b, &product);
+#else
+            T product = static_cast<T>(static_cast<uint64_t>(a) * static_cast<uint64_t>(b));
+            bool overflow = a == -1 ? b == std::numeric_limits<T>::min() : a != 0 && product / a != b;
+#endif
+            flags |= overflow ? T(-1) : T();
+            return product;
+        }
+        else {
+            return a * b;
+        }
+    }
+
+    static T divide(T a, T b, T &) {
+        return a / b;
+    }
+
+    bool hasOverflowed() const {
+        if (overflowed) {
+            return true;
+        }
+        for (const ExpressionPlan &child : children) {
+            if (child.hasOverflowed()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    BlockValues<T> evaluate(size_t begin, size_t count) {
+        switch (op) {
+            case ExpressionOp::Number:
+                return {true, number, nullptr, nullptr};
+            case ExpressionOp::Column:
+                return readColumn(begin, count);
+            case ExpressionOp::Negate: {
+                BlockValues<T> a = children[0].evaluate(begin, count);
+                return apply({true, T(), nullptr, nullptr}, a, count, subtract);
+            }
+            default:
+                break;
+        }
+        BlockValues<T> a = children[0].evaluate(begin, count);
+        BlockValues<T> b = children[1].evaluate(begin, count);
+        switch (op) {
+            case ExpressionOp::Add: return apply(a, b, count, add);
+            case ExpressionOp::Subtract: return apply(a, b, count, subtract);
+            case ExpressionOp::Multiply: return apply(a, b, count, multiply);
+            default: return apply(a, b, count, divide);
+        }
+    }
+};
+
+// Integer evaluation applies when every leaf is integral and nothing divides
+static bool isIntegral(const ExpressionNode &node, const std::vector<std::string> &headers, const std::vector<Column> &columns) {
+    switch (node.op) {
+        case ExpressionOp::Number:
+            return node.isInteger;
+        case ExpressionOp::Column: {
+            auto it = std::find(headers.begin(), headers.end(), node.column);
+            if (it == headers.end()) {
+                return false;
+            }
+            ColumnType type = columns[it - headers.begin()].getType();
+            return type == ColumnType::Int64 || type == ColumnType::Bool;
+        }
+        case ExpressionOp::Divide:
+            return false;
+        default:
+            return isIntegral(*node.left, headers, columns) && (!node.right || isIntegral(*node.right, headers, columns));
+    }
+}
+
+// False when an integer result overflows, leaving result partly filled
+template<typename T>
+static bool evaluateInto(const ExpressionNode &root, const std::vector<std::string> &headers,
+    const std::vector<Column> &columns, size_t rowCount, Column &result) {
+    ExpressionPlan<T> plan(root, headers, columns);
+    result.reserve(rowCount);
+    for (size_t begin = 0; begin < rowCount; begin += BLOCK_ROWS) {
+        size_t count = std::min(BLOCK_ROWS, rowCount - begin);
+        BlockValues<T> block = plan.evaluate(begin, count);
+        if (plan.hasOverflowed()) {
+            return false;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (!block.isScalar && block.valid && !((block.valid[i / 64] >> (i % 64)) & 1)) {
+                result.pushNull();
+            }
+            else if (std::is_integral<T>::value) {
+                result.pushInt(static_cast<int64_t>(block.isScalar ? block.scalar : block.values[i]));
+            }
+            else {
+                result.pushDouble(static_cast<double>(block.isScalar ? block.scalar : block.values[i]));
+            }
+        }
+    }
+    return true;
+}
+
+// Throws std::out_of_range for a missing column. Integer formulas that
+// overflow in any row are evaluated again in doubles, as integer sums widen
+// elsewhere.
+Column Expression::evaluate(const std::vector<std::string> &headers, const std::vector<Column> &columns, size_t rowCount) const {
+    if (isIntegral(*root, headers, columns)) {
+        Column result(ColumnType::Int64);
+        if (evaluateInto<int64_t>(*root, headers, columns, rowCount, result)) {
+            return result;
+        }
+    }
+    Column result(ColumnType::Double);
+    evaluateInto<double>(*root, headers, columns, rowCount, result);
+    return result;
+}
@@ -0,0 +1,47 @@
+#ifndef EXPRESSION_HPP
+#define EXPRESSION_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Column.hpp"
+
+enum class ExpressionOp {
+    Number,
+    Column,
+    Negate,
+    Add,
+    Subtract,
+    Multiply,
+    Divide
+};
+
+struct ExpressionNode {
+    ExpressionOp op;
+    double number;
+    bool isInteger;
+    std::string column;
+    std::unique_ptr<ExpressionNode> left;
+    std::unique_ptr<ExpressionNode> right;
+};
+
+// An arithmetic formula over columns, such as "Salary / 12 + Bonus * 0.5",
+// parsed once into a tree. It takes + - * / with the usual precedence, unary
+// minus, parentheses, numbers and column names; names that are not plain
+// identifiers are written between backticks.
+// Columns are evaluated block by block over the typed buffers, a row is null
+// when any column it reads is null. Formulas using only integer columns and
+// integer constants without division give an Int64 column, others a Double one.
+// An integer formula that overflows in any row gives a Double column instead.
+class Expression {
+private:
+    std::string text;
+    std::shared_ptr<const ExpressionNode> root;
+
+public:
+    explicit Expression(const std::string &text);
+    const std::string &getText() const;
+    Column evaluate(const std::vector<std::string> &headers, const std::vector<Column> &columns, size_t rowCount) const;
+};
+
+#endif  // EXPRESSION_HPP
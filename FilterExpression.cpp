@@ -0,0 +1,167 @@
+#include "FilterExpression.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+// Rows evaluated per block, small enough for the short circuit to skip work
+// and large enough for the compare kernels
+static const size_t BLOCK_ROWS = 2048;
+static const size_t BLOCK_WORDS = BLOCK_ROWS / 64;
+
+FilterExpression::FilterExpression(FilterNode kind, std::vector<FilterExpression> children)
+: kind(kind), children(std::move(children)) {
+    //
+}
+
+FilterExpression::FilterExpression(const std::string &column, const std::string &op, const std::string &value)
+: kind(FilterNode::Leaf), predicate(std::make_shared<Predicate>(column, op, value)) {
+    //
+}
+
+FilterExpression::FilterExpression(const std::string &column, const std::string &op, const char *value)
+: FilterExpression(column, op, std::string(value)) {
+    //
+}
+
+FilterExpression::FilterExpression(const std::string &column, const std::string &op, double value)
+: kind(FilterNode::Leaf), predicate(std::make_shared<Predicate>(column, op, value)) {
+    //
+}
+
+// An expression resolved against the columns, with its operands sorted by cost
+struct FilterPlan {
+    FilterNode kind;
+    const Predicate *predicate;
+    const Column *column;
+    bool constant;
+    int cost;
+    std::vector<FilterPlan> children;
+    std::vector<int8_t> codeResults;
+
+    FilterPlan(const FilterExpression &expression, const std::vector<std::string> &headers,
+        const std::vector<Column> &columns)
+    : kind(expression.kind), predicate(expression.predicate.get()), column(nullptr), constant(false), cost(0) {
+        if (kind != FilterNode::Leaf) {
+            for (const auto &child : expression.children) {
+                children.emplace_back(child, headers, columns);
+                cost += children.back().cost;
+            }
+            std::stable_sort(children.begin(), children.end(), [](const FilterPlan &a, const FilterPlan &b) {
+                return a.cost < b.cost;
+            });
+            return;
+        }
+        auto it = std::find(headers.begin(), headers.end(), predicate->column);
+        if (it != headers.end()) {
+            column = &columns[it - headers.begin()];
+            cost = leafCost();
+        }
+        else if (!predicate->isNumeric) {
+            // Cells of a missing column read as empty
+            constant = predicate->matchesText("");
+        }
+        else {
+            throw std::out_of_range("column not found: " + predicate->column);
+        }
+    }
+
+    // Relative cost per row: SIMD compares, dictionary lookups, string
+    // compares, substring searches, then cells that need parsing or formatting
+    int leafCost() const {
+        bool isLength = predicate->isNumeric && predicate->op == PredicateOp::Length;
+        switch (column->getType()) {
+            case ColumnType::Int64:
+            case ColumnType::Double:
+            case ColumnType::Bool:
+                return predicate->isNumeric && !isLength ? 1 : 6;
+            case ColumnType::Categorical:
+                return 2;
+            default:
+                if (predicate->isNumeric) {
+                    return isLength ? 3 : 5;
+                }
+                return predicate->op == PredicateOp::Equal || predicate->op == PredicateOp::StartsWith ? 3 : 4;
+        }
+    }
+
+    // Fills the words of rows [begin, end), the bits past end stay cleared
+    void evaluate(size_t begin, size_t end, uint64_t *mask) {
+        const size_t count = end - begin;
+        const size_t words = (count + 63) / 64;
+        const uint64_t tail = count % 64 != 0 ? (1ULL << (count % 64)) - 1 : ~0ULL;
+        switch (kind) {
+            case FilterNode::Leaf:
+                if (column) {
+                    predicate->evaluate(*column, begin, end, mask, codeResults);
+                }
+                else {
+                    std::fill(mask, mask + words, constant ? ~0ULL : 0);
+                    mask[words - 1] &= tail;
+                }
+                return;
+            case FilterNode::Not:
+                children[0].evaluate(begin, end, mask);
+                for (size_t w = 0; w < words; ++w) {
+                    mask[w] = ~mask[w];
+                }
+                mask[words - 1] &= tail;
+                return;
+            default:
+                break;
+        }
+        // The block result is settled once no row passes an && or every row
+        // passes an ||
+        const bool isAnd = kind == FilterNode::And;
+        uint64_t operand[BLOCK_WORDS];
+        children[0].evaluate(begin, end, mask);
+        for (size_t i = 1; i < children.size(); ++i) {
+            bool settled = true;
+            for (size_t w = 0; w < words && settled; ++w) {
+                settled = isAnd ? mask[w] == 0 : mask[w] == (w == words - 1 ? tail : ~0ULL);
+            }
+            if (settled) {
+                return;
+            }
+            children[i].evaluate(begin, end, operand);
+            for (size_t w = 0; w < words; ++w) {
+                mask[w] = isAnd ? mask[w] & operand[w] : mask[w] | operand[w];
+            }
+        }
+    }
+};
+
+// Nested operands of the same kind are flattened, so a && b && c is one node
+FilterExpression FilterExpression::combine(FilterNode kind, const FilterExpression &a, const FilterExpression &b) {
+    std::vector<FilterExpression> children;
+    for (const FilterExpression *operand : {&a, &b}) {
+        if (operand->kind == kind) {
+            children.insert(children.end(), operand->children.begin(), operand->children.end());
+        }
+        else {
+            children.push_back(*operand);
+        }
+    }
+    return FilterExpression(kind, std::move(children));
+}
+
+FilterExpression operator&&(const FilterExpression &a, const FilterExpression &b) {
+    return FilterExpression::combine(FilterNode::And, a, b);
+}
+
+FilterExpression operator||(const FilterExpression &a, const FilterExpression &b) {
+    return FilterExpression::combine(FilterNode::Or, a, b);
+}
+
+FilterExpression operator!(const FilterExpression &a) {
+    return FilterExpression(FilterNode::Not, {a});
+}
+
+// Sets one bit per row passing the expression, in the layout of the column
+// validity bitmap
+void FilterExpression::evaluate(const std::vector<std::string> &headers, const std::vector<Column> &columns,
+    size_t rowCount, std::vector<uint64_t> &mask) const {
+    FilterPlan plan(*this, headers, columns);
+    mask.assign((rowCount + 63) / 64, 0);
+    for (size_t begin = 0; begin < rowCount; begin += BLOCK_ROWS) {
+        plan.evaluate(begin, std::min(begin + BLOCK_ROWS, rowCount), mask.data() + begin / 64);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef FILTEREXPRESSION_HPP
+#define FILTEREXPRESSION_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Column.hpp"
+#include "Predicate.hpp"
+
+enum class FilterNode {
+    Leaf,
+    And,
+    Or,
+    Not
+};
+
+// A boolean combination of column predicates, built with &&, || and !:
+//     FilterExpression("Age", ">", 25.) && !FilterExpression("City", "==", "Boston")
+// All conditions are evaluated in one scan over blocks of rows. Within a block
+// the operands of && and || run cheapest first, ranked by column type and
+// operator, and stop once the block result is settled. ! inverts the set of
+// rows, so it keeps the rows a predicate rejects for being null.
+class FilterExpression {
+private:
+    FilterNode kind;
+    std::shared_ptr<const Predicate> predicate;
+    std::vector<FilterExpression> children;
+    FilterExpression(FilterNode kind, std::vector<FilterExpression> children);
+    static FilterExpression combine(FilterNode kind, const FilterExpression &a, const FilterExpression &b);
+
+public:
+    FilterExpression(const std::string &column, const std::string &op, const std::string &value);
+    FilterExpression(const std::string &column, const std::string &op, const char *value);
+    FilterExpression(const std::string &column, const std::string &op, double value);
+    void evaluate(const std::vector<std::string> &headers, const std::vector<Column> &columns,
+        size_t rowCount, std::vector<uint64_t> &mask) const;
+    friend FilterExpression operator&&(const FilterExpression &a, const FilterExpression &b);
+    friend FilterExpression operator||(const FilterExpression &a, const FilterExpression &b);
+    friend FilterExpression operator!(const FilterExpression &a);
+    friend struct FilterPlan;
+};
+
+#endif  // FILTEREXPRESSION_HPP
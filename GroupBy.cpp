@@ -0,0 +1,750 @@
+#include "GroupBy.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <xmmintrin.h>
+#define PREFETCH(address) _mm_prefetch(reinterpret_cast<const char *>(address), _MM_HINT_T0)
+#else
+#define PREFETCH(address)
+#endif
+
+// Rows whose keys are encoded and looked up together
+static const size_t BLOCK_ROWS = 1024;
+static const size_t NO_ROW = static_cast<size_t>(-1);
+static const uint64_t TAG_MASK = 0xffffffff00000000ULL;
+
+static AggregateOp parseAggregate(const std::string &op) {
+    if (op == "sum") return AggregateOp::Sum;
+    if (op == "mean") return AggregateOp::Mean;
+    if (op == "count") return AggregateOp::Count;
+    if (op == "min") return AggregateOp::Min;
+    if (op == "max") return AggregateOp::Max;
+    if (op == "first") return AggregateOp::First;
+    if (op == "last") return AggregateOp::Last;
+    throw std::invalid_argument("unknown aggregation: " + op);
+}
+
+Aggregation::Aggregation(const std::string &column, const std::string &op, const std::string &name)
+: column(column), op(parseAggregate(op)), name(name.empty() ? column + "_" + op : name) {
+    //
+}
+
+static uint64_t mixHash(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static bool isValid(const uint64_t *validity, size_t row) {
+    return !validity || ((validity[row / 64] >> (row % 64)) & 1);
+}
+
+// Calls fn(i, row) for positions [first, first + count) of rows, with a
+// separate loop for consecutive rows
+template<typename Fn>
+static void forRows(const RowSet &rows, size_t first, size_t count, Fn fn) {
+    if (rows.rows) {
+        for (size_t i = 0; i < count; ++i) {
+            fn(i, rows.rows[first + i]);
+        }
+    }
+    else {
+        for (size_t i = 0; i < count; ++i) {
+            fn(i, rows.begin + first + i);
+        }
+    }
+}
+
+// Ids start at 1, 0 being left for nulls
+uint32_t GroupTable::StringIds::find(std::string_view value) {
+    uint64_t hash = std::hash<std::string_view>()(value);
+    if ((values.size() + 1) * 2 > slots.size()) {
+        std::vector<uint32_t> grown(std::max<size_t>(slots.size() * 2, 64), 0);
+        size_t mask = grown.size() - 1;
+        for (size_t id = 0; id < values.size(); ++id) {
+            size_t slot = hashes[id] & mask;
+            while (grown[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            grown[slot] = static_cast<uint32_t>(id + 1);
+        }
+        slots.swap(grown);
+    }
+    size_t mask = slots.size() - 1;
+    size_t slot = hash & mask;
+    while (slots[slot] != 0) {
+        uint32_t id = slots[slot] - 1;
+        if (hashes[id] == hash && values[id] == value) {
+            return id + 1;
+        }
+        slot = (slot + 1) & mask;
+    }
+    slots[slot] = static_cast<uint32_t>(values.size() + 1);
+    values.push_back(value);
+    hashes.push_back(hash);
+    return static_cast<uint32_t>(values.size());
+}
+
+// A word per key column, then a word of null flags when a key can be null
+GroupTable::GroupTable(const std::vector<const Column *> &keys)
+: keys(keys), stringIds(keys.size()), hasNullWord(false), slots(64, 0) {
+    for (const Column *key : keys) {
+        if (key->nullCount() > 0 || key->getType() == ColumnType::String) {
+            hasNullWord = true;
+        }
+    }
+    width = keys.size() + (hasNullWord ? 1 : 0);
+}
+
+// Writes the word of key column k for positions [first, first + count) of
+// rows into the block of row keys. Null cells take the word 0 and raise their
+// flag.
+void GroupTable::encodeKeys(size_t k, const RowSet &rows, size_t first, size_t count) {
+    const Column &key = *keys[k];
+    uint64_t *out = rowKeys.data() + k;
+    const size_t width = this->width;
+    switch (key.getType()) {
+        case ColumnType::Int64: {
+            const int64_t *values = key.intData().data();
+            forRows(rows, first, count, [&](size_t i, size_t row) {
+                out[i * width] = static_cast<uint64_t>(values[row]);
+            });
+            break;
+        }
+        case ColumnType::Double: {
+            // -0 joins 0 and every NaN joins one group
+            const double *values = key.doubleData().data();
+            forRows(rows, first, count, [&](size_t i, size_t row) {
+                double value = values[row] == 0 ? 0. : values[row];
+                if (std::isnan(value)) {
+                    value = std::nan("");
+                }
+                std::memcpy(&out[i * width], &value, sizeof(value));
+            });
+            break;
+        }
+        case ColumnType::Bool: {
+            const uint8_t *values = key.boolData().data();
+            forRows(rows, first, count, [&](size_t i, size_t row) {
+                out[i * width] = values[row];
+            });
+            break;
+        }
+        case ColumnType::Categorical: {
+            const int32_t *values = key.codeData().data();
+            forRows(rows, first, count, [&](size_t i, size_t row) {
+                out[i * width] = static_cast<uint32_t>(values[row]);
+            });
+            break;
+        }
+        default: {
+            const std::string_view *values = key.stringData().data();
+            StringIds &ids = stringIds[k];
+            forRows(rows, first, count, [&](size_t i, size_t row) {
+                out[i * width] = values[row].empty() ? 0 : ids.find(values[row]);
+            });
+            break;
+        }
+    }
+    if (key.nullCount() > 0) {
+        const uint64_t *validity = key.validityData().data();
+        const size_t flags = keys.size();
+        forRows(rows, first, count, [&](size_t i, size_t row) {
+            if (!isValid(validity, row)) {
+                out[i * width] = 0;
+                rowKeys[i * width + flags] |= 1ULL << (k % 64);
+            }
+        });
+    }
+}
+
+// A slot holds the high half of the hash above the group id plus one
+static uint64_t slotEntry(uint64_t hash, size_t id) {
+    return (hash & TAG_MASK) | (id + 1);
+}
+
+void GroupTable::grow() {
+    std::vector<uint64_t> grown(slots.size() * 2, 0);
+    size_t mask = grown.size() - 1;
+    for (size_t id = 0; id < groupHashes.size(); ++id) {
+        size_t slot = groupHashes[id] & mask;
+        while (grown[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        grown[slot] = slotEntry(groupHashes[id], id);
+    }
+    slots.swap(grown);
+}
+
+// Sets groupIds[i] to the group of rows[i], rows with unseen keys opening new
+// groups
+void GroupTable::insert(const RowSet &rows, uint32_t *groupIds) {
+    rowKeys.resize(BLOCK_ROWS * width);
+    rowHashes.resize(BLOCK_ROWS);
+    for (size_t first = 0; first < rows.count; first += BLOCK_ROWS) {
+        size_t count = std::min(BLOCK_ROWS, rows.count - first);
+        if (hasNullWord) {
+            for (size_t i = 0; i < count; ++i) {
+                rowKeys[i * width + keys.size()] = 0;
+            }
+        }
+        // Key words are filled a column at a time
+        for (size_t k = 0; k < keys.size(); ++k) {
+            encodeKeys(k, rows, first, count);
+        }
+        size_t mask = slots.size() - 1;
+        for (size_t i = 0; i < count; ++i) {
+            const uint64_t *rowKey = rowKeys.data() + i * width;
+            uint64_t hash = 0;
+            for (size_t w = 0; w < width; ++w) {
+                hash = mixHash(hash + rowKey[w]);
+            }
+            rowHashes[i] = hash;
+            PREFETCH(&slots[hash & mask]);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            const uint64_t *rowKey = rowKeys.data() + i * width;
+            const uint64_t hash = rowHashes[i];
+            mask = slots.size() - 1;
+            size_t slot = hash & mask;
+            size_t id = 0;
+            while (slots[slot] != 0) {
+                uint64_t entry = slots[slot];
+                size_t candidate = static_cast<uint32_t>(entry) - 1;
+                if ((entry & TAG_MASK) == (hash & TAG_MASK) &&
+                    std::equal(rowKey, rowKey + width, groupKeys.begin() + candidate * width)) {
+                    id = candidate + 1;
+                    break;
+                }
+                slot = (slot + 1) & mask;
+            }
+            if (id == 0) {
+                id = groupRows.size() + 1;
+                slots[slot] = slotEntry(hash, id - 1);
+                groupHashes.push_back(hash);
+                groupKeys.insert(groupKeys.end(), rowKey, rowKey + width);
+                groupRows.push_back(rows[first + i]);
+                if (groupRows.size() * 2 > slots.size()) {
+                    grow();
+                }
+            }
+            groupIds[first + i] = static_cast<uint32_t>(id - 1);
+        }
+    }
+}
+
+// Sets groupIds[i - begin] for rows [begin, end)
+void GroupTable::insert(size_t begin, size_t end, uint32_t *groupIds) {
+    insert(RowSet{nullptr, begin, end - begin}, groupIds);
+}
+
+size_t GroupTable::size() const {
+    return groupRows.size();
+}
+
+// The row where each group was first seen
+const std::vector<size_t> &GroupTable::firstRows() const {
+    return groupRows;
+}
+
+Aggregator::Aggregator(const Column &column, AggregateOp op)
+: column(column), op(op) {
+    //
+}
+
+// Integer and bool columns are summed exactly as integers, the result widened
+// to doubles when a group sum overflows
+bool Aggregator::sumsInts() const {
+    return op == AggregateOp::Sum && (column.getType() == ColumnType::Int64 || column.getType() == ColumnType::Bool);
+}
+
+// Whether row replaces best as the min or max, text comparing bytewise
+bool Aggregator::isBetter(size_t row, size_t best) const {
+    bool isMin = op == AggregateOp::Min;
+    switch (column.getType()) {
+        case ColumnType::Int64: {
+            int64_t a = column.intData()[row];
+            int64_t b = column.intData()[best];
+            return isMin ? a < b : a > b;
+        }
+        case ColumnType::Double: {
+            double a = column.doubleData()[row];
+            double b = column.doubleData()[best];
+            return isMin ? a < b : a > b;
+        }
+        case ColumnType::Bool: {
+            uint8_t a = column.boolData()[row];
+            uint8_t b = column.boolData()[best];
+            return isMin ? a < b : a > b;
+        }
+        case ColumnType::Categorical: {
+            std::string_view a = column.dictionaryData()[column.codeData()[row]];
+            std::string_view b = column.dictionaryData()[column.codeData()[best]];
+            return isMin ? a < b : a > b;
+        }
+        default: {
+            std::string_view a = column.stringData()[row];
+            std::string_view b = column.stringData()[best];
+            return isMin ? a < b : a > b;
+        }
+    }
+}
+
+// Adds the valid values of rows to the states of their groups
+template<typename S, typename V>
+static void addValues(std::vector<S> &states, const RowSet &rows, const uint32_t *groupIds, const V *values,
+    const uint64_t *validity) {
+    forRows(rows, 0, rows.count, [&](size_t i, size_t row) {
+        if (isValid(validity, row)) {
+            S &state = states[groupIds[i]];
+            state.sum += values[row];
+            ++state.count;
+        }
+    });
+}
+
+// Adds the valid values of rows to the states of their groups as addValues,
+// with a sum that overflows wrapping around and the wrap counted in the carry of
+// its group, so that the exact total is sum + carry * 2^64. Carries are only
+// allocated on the first overflow.
+template<typename S>
+static void addInts(std::vector<S> &states, std::vector<int64_t> &carries, const RowSet &rows,
+    const uint32_t *groupIds, const int64_t *values, const uint64_t *validity) {
+    forRows(rows, 0, rows.count, [&](size_t i, size_t row) {
+        if (isValid(validity, row)) {
+            S &state = states[groupIds[i]];
+            const int64_t value = values[row];
+            const int64_t sum = static_cast<int64_t>(static_cast<uint64_t>(state.sum) + static_cast<uint64_t>(value));
+            if (((state.sum ^ sum) & (value ^ sum)) < 0) {
+                carries.resize(states.size(), 0);
+                carries[groupIds[i]] += value < 0 ? -1 : 1;
+            }
+            state.sum = sum;
+            ++state.count;
+        }
+    });
+}
+
+// Keeps for each group the valid row with the least or the greatest value,
+// NaN being skipped
+template<typename S, typename V>
+static void pickValues(std::vector<S> &states, const RowSet &rows, const uint32_t *groupIds, const V *values,
+    const uint64_t *validity, bool isMin) {
+    forRows(rows, 0, rows.count, [&](size_t i, size_t row) {
+        V value = values[row];
+        if (!isValid(validity, row) || value != value) {
+            return;
+        }
+        S &state = states[groupIds[i]];
+        if (state.row == NO_ROW || (isMin ? value < state.value : value > state.value)) {
+            state.value = value;
+            state.row = row;
+        }
+    });
+}
+
+// Takes rows in increasing order, groupIds[i] being the group of rows[i] and
+// every id below groupCount. Sums of text cells parse them as getDouble does.
+void Aggregator::update(const RowSet &rows, const uint32_t *groupIds, size_t groupCount) {
+    const uint64_t *validity = column.nullCount() > 0 ? column.validityData().data() : nullptr;
+    switch (op) {
+        case AggregateOp::Count:
+            counts.resize(groupCount, 0);
+            forRows(rows, 0, rows.count, [&](size_t i, size_t row) {
+                counts[groupIds[i]] += isValid(validity, row);
+            });
+            break;
+        case AggregateOp::Sum:
+        case AggregateOp::Mean:
+            if (sumsInts()) {
+                intSums.resize(groupCount, {0, 0});
+                if (column.getType() == ColumnType::Int64) {
+                    addInts(intSums, carries, rows, groupIds, column.intData().data(), validity);
+                }
+                else {
+                    addValues(intSums, rows, groupIds, column.boolData().data(), validity);
+                }
+                break;
+            }
+            sums.resize(groupCount, {0., 0});
+            switch (column.getType()) {
+                case ColumnType::Double:
+                    addValues(sums, rows, groupIds, column.doubleData().data(), validity);
+                    break;
+                case ColumnType::Int64:
+                    addValues(sums, rows, groupIds, column.intData().data(), validity);
+                    break;
+                case ColumnType::Bool:
+                    addValues(sums, rows, groupIds, column.boolData().data(), validity);
+                    break;
+                default:
+                    forRows(rows, 0, rows.count, [&](size_t i, size_t row) {
+                        if (!column.isNull(row)) {
+                            SumState<double> &state = sums[groupIds[i]];
+                            state.sum += column.getDouble(row);
+                            ++state.count;
+                        }
+                    });
+                    break;
+            }
+            break;
+        case AggregateOp::Min:
+        case AggregateOp::Max:
+            if (column.getType() == ColumnType::Int64) {
+                intPicks.resize(groupCount, {0, NO_ROW});
+                pickValues(intPicks, rows, groupIds, column.intData().data(), validity, op == AggregateOp::Min);
+                break;
+            }
+            if (column.getType() == ColumnType::Double) {
+                doublePicks.resize(groupCount, {0., NO_ROW});
+                pickValues(doublePicks, rows, groupIds, column.doubleData().data(), validity, op == AggregateOp::Min);
+                break;
+            }
+            // fall through
+        default:
+            this->rows.resize(groupCount, NO_ROW);
+            forRows(rows, 0, rows.count, [&](size_t i, size_t row) {
+                if (!isValid(validity, row)) {
+                    return;
+                }
+                if (column.getType() == ColumnType::Double && std::isnan(column.doubleData()[row])) {
+                    return;
+                }
+                size_t &best = this->rows[groupIds[i]];
+                if (best == NO_ROW || op == AggregateOp::Last ||
+                    (op != AggregateOp::First && isBetter(row, best))) {
+                    best = row;
+                }
+            });
+            break;
+    }
+}
+
+// Takes rows [begin, end), groupIds[i - begin] being the group of row i
+void Aggregator::update(const uint32_t *groupIds, size_t begin, size_t end, size_t groupCount) {
+    update(RowSet{nullptr, begin, end - begin}, groupIds, groupCount);
+}
+
+// The column of the results in group id order
+Column Aggregator::finish(const std::vector<size_t> &firstRows) const {
+    std::vector<GroupRef> order(firstRows.size());
+    for (size_t g = 0; g < order.size(); ++g) {
+        order[g] = {0, static_cast<uint32_t>(g)};
+    }
+    return finish({this}, order, firstRows);
+}
+
+// The column of the results of the groups of order, group g being group
+// order[g].group of parts[order[g].part] and first seen at firstRows[g]. All
+// parts aggregate the same column with the same op. Groups without values
+// take their first row, null in the column, for min, max, first and last.
+Column Aggregator::finish(const std::vector<const Aggregator *> &parts, const std::vector<GroupRef> &order,
+    const std::vector<size_t> &firstRows) {
+    const Aggregator &base = *parts[0];
+    const Column &column = base.column;
+    const AggregateOp op = base.op;
+    switch (op) {
+        case AggregateOp::Count: {
+            Column result(ColumnType::Int64);
+            result.reserve(order.size());
+            for (const GroupRef &ref : order) {
+                const std::vector<int64_t> &counts = parts[ref.part]->counts;
+                result.pushInt(ref.group < counts.size() ? counts[ref.group] : 0);
+            }
+            return result;
+        }
+        case AggregateOp::Sum:
+        case AggregateOp::Mean: {
+            const bool isInt = base.sumsInts();
+            bool isWide = false;
+            for (const Aggregator *part : parts) {
+                for (int64_t carry : part->carries) {
+                    isWide = isWide || carry != 0;
+                }
+            }
+            Column result(isInt && !isWide ? ColumnType::Int64 : ColumnType::Double);
+            if (op == AggregateOp::Sum && column.getType() == ColumnType::Double) {
+                result.setPrecision(column.getPrecision());
+            }
+            result.reserve(order.size());
+            for (const GroupRef &ref : order) {
+                const Aggregator &part = *parts[ref.part];
+                if (isInt) {
+                    if (ref.group >= part.intSums.size() || part.intSums[ref.group].count == 0) {
+                        result.pushNull();
+                    }
+                    else if (!isWide) {
+                        result.pushInt(part.intSums[ref.group].sum);
+                    }
+                    else {
+                        int64_t carry = ref.group < part.carries.size() ? part.carries[ref.group] : 0;
+                        result.pushDouble(static_cast<double>(carry) * 18446744073709551616.0 +
+                            static_cast<double>(part.intSums[ref.group].sum));
+                    }
+                    continue;
+                }
+                if (ref.group >= part.sums.size() || part.sums[ref.group].count == 0) {
+                    result.pushNull();
+                    continue;
+                }
+                const SumState<double> &state = part.sums[ref.group];
+                result.pushDouble(op == AggregateOp::Sum ? state.sum : state.sum / static_cast<double>(state.count));
+            }
+            return result;
+        }
+        default: {
+            std::vector<size_t> picked(firstRows);
+            for (size_t g = 0; g < order.size(); ++g) {
+                const Aggregator &part = *parts[order[g].part];
+                const size_t group = order[g].group;
+                size_t row = group < part.rows.size() ? part.rows[group] : NO_ROW;
+                row = group < part.intPicks.size() ? part.intPicks[group].row : row;
+                row = group < part.doublePicks.size() ? part.doublePicks[group].row : row;
+                if (row != NO_ROW) {
+                    picked[g] = row;
+                }
+            }
+            return column.copyRows(picked);
+        }
+    }
+}
+
+// Text of a string or categorical cell
+static std::string_view textAt(const Column &column, size_t row) {
+    if (column.getType() == ColumnType::Categorical) {
+        return column.dictionaryData()[column.codeData()[row]];
+    }
+    return column.stringData()[row];
+}
+
+static int compareCells(const Column &a, size_t rowA, const Column &b, size_t rowB) {
+    const bool nullA = a.isNull(rowA);
+    const bool nullB = b.isNull(rowB);
+    if (nullA || nullB) {
+        return static_cast<int>(nullB) - static_cast<int>(nullA);
+    }
+    bool numberA = a.isNumeric() || a.getType() == ColumnType::Bool;
+    bool numberB = b.isNumeric() || b.getType() == ColumnType::Bool;
+    // Batches of one input may infer different types for a column, text that
+    // holds a number then compares with numbers by value
+    double parsed;
+    if (numberA != numberB && parseDouble(numberA ? textAt(b, rowB) : textAt(a, rowA), parsed)) {
+        numberA = numberB = true;
+    }
+    if (numberA && numberB) {
+        if (a.getType() == ColumnType::Int64 && b.getType() == ColumnType::Int64) {
+            int64_t x = a.intData()[rowA];
+            int64_t y = b.intData()[rowB];
+            return (x > y) - (x < y);
+        }
+        double x = a.getDouble(rowA);
+        double y = b.getDouble(rowB);
+        if (std::isnan(x) || std::isnan(y)) {
+            return static_cast<int>(std::isnan(x)) - static_cast<int>(std::isnan(y));
+        }
+        return (x > y) - (x < y);
+    }
+    int order = !numberA && !numberB ? textAt(a, rowA).compare(textAt(b, rowB)) : a.get(rowA).compare(b.get(rowB));
+    return (order > 0) - (order < 0);
+}
+
+int compareKeys(const std::vector<const Column *> &a, size_t rowA, const std::vector<const Column *> &b, size_t rowB) {
+    for (size_t k = 0; k < a.size(); ++k) {
+        int order = compareCells(*a[k], rowA, *b[k], rowB);
+        if (order != 0) {
+            return order;
+        }
+    }
+    return 0;
+}
+
+bool findRuns(const std::vector<const Column *> &keys, size_t rowCount, int &direction,
+    std::vector<uint32_t> &groupIds, std::vector<size_t> &firstRows) {
+    groupIds.resize(rowCount);
+    firstRows.clear();
+    int found = direction;
+    for (size_t row = 0; row < rowCount; ++row) {
+        int order = row == 0 ? 1 : compareKeys(keys, row - 1, keys, row);
+        if (order != 0) {
+            if (row > 0) {
+                int step = order < 0 ? 1 : -1;
+                if (found != 0 && step != found) {
+                    return false;
+                }
+                found = step;
+            }
+            firstRows.push_back(row);
+        }
+        groupIds[row] = static_cast<uint32_t>(firstRows.size() - 1);
+    }
+    direction = found;
+    return true;
+}
+
+// Below this many rows grouping stays on the calling thread
+static const size_t PARALLEL_ROWS = 1 << 16;
+
+// Hashes the keys of rows [begin, begin + count) from their values alone, so
+// that rows can be split by key before any table is built
+static void hashKeys(const std::vector<const Column *> &keys, size_t begin, size_t count, uint64_t *hashes) {
+    const uint64_t NULL_WORD = 0x9e3779b97f4a7c15ULL;
+    std::fill(hashes, hashes + count, 0);
+    for (const Column *key : keys) {
+        const uint64_t *validity = key->nullCount() > 0 ? key->validityData().data() : nullptr;
+        auto addWords = [&](auto word) {
+            for (size_t i = 0; i < count; ++i) {
+                hashes[i] = mixHash(hashes[i] + (isValid(validity, begin + i) ? word(begin + i) : NULL_WORD));
+            }
+        };
+        switch (key->getType()) {
+            case ColumnType::Int64: {
+                const int64_t *values = key->intData().data();
+                addWords([values](size_t row) { return static_cast<uint64_t>(values[row]); });
+                break;
+            }
+            case ColumnType::Double: {
+                const double *values = key->doubleData().data();
+                addWords([values, NULL_WORD](size_t row) {
+                    double value = values[row] == 0 ? 0. : values[row];
+                    uint64_t word = NULL_WORD;
+                    if (!std::isnan(value)) {
+                        std::memcpy(&word, &value, sizeof(word));
+                    }
+                    return word;
+                });
+                break;
+            }
+            case ColumnType::Bool: {
+                const uint8_t *values = key->boolData().data();
+                addWords([values](size_t row) { return static_cast<uint64_t>(values[row]); });
+                break;
+            }
+            case ColumnType::Categorical: {
+                const int32_t *values = key->codeData().data();
+                addWords([values](size_t row) { return static_cast<uint64_t>(static_cast<uint32_t>(values[row])); });
+                break;
+            }
+            default: {
+                const std::string_view *values = key->stringData().data();
+                addWords([values, NULL_WORD](size_t row) {
+                    return values[row].empty() ? NULL_WORD : static_cast<uint64_t>(std::hash<std::string_view>()(values[row]));
+                });
+                break;
+            }
+        }
+    }
+}
+
+void aggregateGroups(const std::vector<const Column *> &keys, const std::vector<const Column *> &values,
+    const std::vector<AggregateOp> &ops, size_t rowCount, unsigned threads,
+    std::vector<size_t> &firstRows, std::vector<Column> &results) {
+    const unsigned workers = threadCount(threads);
+    results.clear();
+    std::vector<uint32_t> runIds;
+    int direction = 0;
+    if (findRuns(keys, rowCount, direction, runIds, firstRows)) {
+        results.resize(ops.size());
+        parallelFor(ops.size(), workers, [&](size_t a) {
+            Aggregator aggregator(*values[a], ops[a]);
+            aggregator.update(runIds.data(), 0, rowCount, firstRows.size());
+            results[a] = aggregator.finish(firstRows);
+        });
+        return;
+    }
+    std::vector<uint32_t>().swap(runIds);
+    if (workers <= 1 || rowCount < PARALLEL_ROWS) {
+        GroupTable groups(keys);
+        std::vector<uint32_t> groupIds(rowCount);
+        groups.insert(0, rowCount, groupIds.data());
+        for (size_t a = 0; a < ops.size(); ++a) {
+            Aggregator aggregator(*values[a], ops[a]);
+            aggregator.update(groupIds.data(), 0, rowCount, groups.size());
+            results.push_back(aggregator.finish(groups.firstRows()));
+        }
+        firstRows = groups.firstRows();
+        return;
+    }
+
+    // Each chunk of rows lists its rows of every partition, in row order
+    const size_t partitionCount = std::min<size_t>(workers * 4, 256);
+    const size_t chunkRows = (rowCount + workers - 1) / workers;
+    std::vector<std::vector<std::vector<size_t>>> chunkParts(workers, std::vector<std::vector<size_t>>(partitionCount));
+    parallelFor(workers, workers, [&](size_t c) {
+        std::vector<uint64_t> hashes(BLOCK_ROWS);
+        const size_t end = std::min(rowCount, (c + 1) * chunkRows);
+        for (size_t begin = c * chunkRows; begin < end; begin += BLOCK_ROWS) {
+            size_t count = std::min(BLOCK_ROWS, end - begin);
+            hashKeys(keys, begin, count, hashes.data());
+            for (size_t i = 0; i < count; ++i) {
+                chunkParts[c][hashes[i] % partitionCount].push_back(begin + i);
+            }
+        }
+    });
+
+    // Partitions share no key, each is grouped and aggregated by one worker
+    std::vector<std::vector<size_t>> partFirstRows(partitionCount);
+    std::vector<std::vector<Aggregator>> aggregators(partitionCount);
+    parallelFor(partitionCount, workers, [&](size_t p) {
+        std::vector<size_t> rows;
+        for (auto &parts : chunkParts) {
+            rows.insert(rows.end(), parts[p].begin(), parts[p].end());
+            std::vector<size_t>().swap(parts[p]);
+        }
+        const RowSet rowSet{rows.data(), 0, rows.size()};
+        GroupTable groups(keys);
+        std::vector<uint32_t> groupIds(rows.size());
+        groups.insert(rowSet, groupIds.data());
+        aggregators[p].reserve(ops.size());
+        for (size_t a = 0; a < ops.size(); ++a) {
+            aggregators[p].emplace_back(*values[a], ops[a]);
+            aggregators[p].back().update(rowSet, groupIds.data(), groups.size());
+        }
+        partFirstRows[p] = groups.firstRows();
+    });
+
+    // The groups of the partitions are merged back by first row
+    typedef std::pair<size_t, uint32_t> Head;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    std::vector<uint32_t> next(partitionCount, 0);
+    size_t groupCount = 0;
+    for (size_t p = 0; p < partitionCount; ++p) {
+        groupCount += partFirstRows[p].size();
+        if (!partFirstRows[p].empty()) {
+            heads.push({partFirstRows[p][0], static_cast<uint32_t>(p)});
+        }
+    }
+    std::vector<Aggregator::GroupRef> order;
+    order.reserve(groupCount);
+    firstRows.clear();
+    firstRows.reserve(groupCount);
+    while (!heads.empty()) {
+        uint32_t p = heads.top().second;
+        heads.pop();
+        uint32_t group = next[p]++;
+        order.push_back({p, group});
+        firstRows.push_back(partFirstRows[p][group]);
+        if (next[p] < partFirstRows[p].size()) {
+            heads.push({partFirstRows[p][next[p]], p});
+        }
+    }
+
+    results.resize(ops.size());
+    parallelFor(ops.size(), workers, [&](size_t a) {
+        std::vector<const Aggregator *> parts(partitionCount);
+        for (size_t p = 0; p < partitionCount; ++p) {
+            parts[p] = &aggregators[p][a];
+        }
+        results[a] = Aggregator::finish(parts, order, firstRows);
+    });
+}
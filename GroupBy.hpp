@@ -0,0 +1,141 @@
+#ifndef GROUPBY_HPP
+#define GROUPBY_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Column.hpp"
+
+enum class AggregateOp {
+    Sum,
+    Mean,
+    Count,
+    Min,
+    Max,
+    First,
+    Last
+};
+
+// One output column of a grouping: sum, mean, count, min, max, first or last
+// of a column over the rows of each group, named column_op unless given a name.
+// Nulls are skipped, a group without values gets a null except for count.
+struct Aggregation {
+    std::string column;
+    AggregateOp op;
+    std::string name;
+    Aggregation(const std::string &column, const std::string &op, const std::string &name = "");
+};
+
+// Rows [begin, begin + count), or the count rows listed in rows
+struct RowSet {
+    const size_t *rows;
+    size_t begin;
+    size_t count;
+    size_t operator[](size_t i) const {
+        return rows ? rows[i] : begin + i;
+    }
+};
+
+// Assigns dense group ids, in order of first appearance, to the rows of a set
+// of key columns. Each key cell is turned into a 64-bit word (strings through
+// an id per distinct value) and rows are looked up by these words in a flat
+// open addressing table. A slot holds the group id and the high half of its
+// hash, and the slots of a block of rows are prefetched before probing.
+class GroupTable {
+private:
+    struct StringIds {
+        std::vector<uint32_t> slots;
+        std::vector<std::string_view> values;
+        std::vector<uint64_t> hashes;
+        uint32_t find(std::string_view value);
+    };
+
+    std::vector<const Column *> keys;
+    std::vector<StringIds> stringIds;
+    size_t width;
+    bool hasNullWord;
+    std::vector<uint64_t> slots;
+    std::vector<uint64_t> groupHashes;
+    std::vector<uint64_t> groupKeys;
+    std::vector<size_t> groupRows;
+    std::vector<uint64_t> rowKeys;
+    std::vector<uint64_t> rowHashes;
+    void encodeKeys(size_t k, const RowSet &rows, size_t first, size_t count);
+    void grow();
+
+public:
+    explicit GroupTable(const std::vector<const Column *> &keys);
+    void insert(const RowSet &rows, uint32_t *groupIds);
+    void insert(size_t begin, size_t end, uint32_t *groupIds);
+    size_t size() const;
+    const std::vector<size_t> &firstRows() const;
+};
+
+// Running values of one aggregation for every group, fed with rows and their
+// group ids. A group's sum and count sit side by side, as do the
+// min or max of a numeric column and its row.
+class Aggregator {
+private:
+    template<typename T>
+    struct SumState {
+        T sum;
+        int64_t count;
+    };
+
+    template<typename T>
+    struct PickState {
+        T value;
+        size_t row;
+    };
+
+    const Column &column;
+    AggregateOp op;
+    std::vector<int64_t> counts;
+    std::vector<SumState<int64_t>> intSums;
+    std::vector<int64_t> carries;
+    std::vector<SumState<double>> sums;
+    std::vector<PickState<int64_t>> intPicks;
+    std::vector<PickState<double>> doublePicks;
+    std::vector<size_t> rows;
+    bool sumsInts() const;
+    bool isBetter(size_t row, size_t best) const;
+
+public:
+    // A group of one of several aggregators over disjoint groups
+    struct GroupRef {
+        uint32_t part;
+        uint32_t group;
+    };
+
+    Aggregator(const Column &column, AggregateOp op);
+    void update(const RowSet &rows, const uint32_t *groupIds, size_t groupCount);
+    void update(const uint32_t *groupIds, size_t begin, size_t end, size_t groupCount);
+    Column finish(const std::vector<size_t> &firstRows) const;
+    static Column finish(const std::vector<const Aggregator *> &parts, const std::vector<GroupRef> &order,
+        const std::vector<size_t> &firstRows);
+};
+
+// Orders the keys of row rowA of a and row rowB of b, giving -1, 0 or 1.
+// Nulls come first, numbers compare by value with NaN last, text bytewise.
+int compareKeys(const std::vector<const Column *> &a, size_t rowA, const std::vector<const Column *> &b, size_t rowB);
+
+// Sets the group ids and first rows of rows [0, rowCount) when their keys are
+// sorted, a group being a run of equal keys; false when they are not. The
+// direction is 1 for ascending keys and -1 for descending ones, 0 while
+// unknown: a known direction must be kept and an unknown one is set.
+bool findRuns(const std::vector<const Column *> &keys, size_t rowCount, int &direction,
+    std::vector<uint32_t> &groupIds, std::vector<size_t> &firstRows);
+
+// Groups rows [0, rowCount) by the keys and computes aggregation i, op i over
+// values i, giving the first row of each group in order of appearance and a
+// result column per aggregation. Rows already sorted on the keys are grouped
+// by runs of equal keys, without a hash table. With several threads the rows are split by a
+// hash of their keys into partitions, each grouped and aggregated on its own:
+// partitions hold disjoint groups, so their results are only interleaved
+// back into order of appearance, with no merging of partial aggregates.
+void aggregateGroups(const std::vector<const Column *> &keys, const std::vector<const Column *> &values,
+    const std::vector<AggregateOp> &ops, size_t rowCount, unsigned threads,
+    std::vector<size_t> &firstRows, std::vector<Column> &results);
+
+#endif  // GROUPBY_HPP
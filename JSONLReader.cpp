@@ -0,0 +1,228 @@
+#include "JSONLReader.hpp"
+#include "CSVReader.hpp"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+using json = nlohmann::json;
+
+// SAX handler filling the columns with the records of one line at a time
+class RecordHandler {
+private:
+    std::vector<std::string> &headers;
+    std::vector<Column> &columns;
+    const std::vector<std::string> &categoricalColumns;
+    std::unordered_map<std::string, size_t> columnIndex;
+    size_t rows;
+    size_t depth;
+    size_t current;
+    size_t expected;
+    // Nested values being rebuilt, with the last key read inside them
+    json nestedRoot;
+    std::vector<json *> nested;
+    std::string nestedKey;
+
+    // Column of a key, usually the one after the previous key of the line
+    size_t findColumn(const std::string &key) {
+        if (expected < headers.size() && headers[expected] == key) {
+            return expected++;
+        }
+        auto it = columnIndex.find(key);
+        if (it == columnIndex.end()) {
+            bool isCategorical = std::find(categoricalColumns.begin(), categoricalColumns.end(), key) != categoricalColumns.end();
+            it = columnIndex.emplace(key, columns.size()).first;
+            headers.push_back(key);
+            columns.emplace_back(isCategorical ? ColumnType::Categorical : ColumnType::String);
+            columns.back().resize(rows);
+        }
+        expected = it->second + 1;
+        return it->second;
+    }
+
+    // The first value of a repeated key is kept
+    bool pushValue(std::string_view text, bool isNull = false) {
+        if (depth == 0) {
+            error = "expected a JSON object";
+            return false;
+        }
+        Column &column = columns[current];
+        if (column.size() == rows) {
+            if (isNull) {
+                column.pushNull();
+            }
+            else {
+                column.push_back(text);
+            }
+        }
+        return true;
+    }
+
+    bool addNested(json &&value) {
+        if (nested.back()->is_array()) {
+            nested.back()->push_back(std::move(value));
+        }
+        else {
+            (*nested.back())[nestedKey] = std::move(value);
+        }
+        return true;
+    }
+
+    bool beginNested(json &&value) {
+        if (nested.empty()) {
+            nestedRoot = std::move(value);
+            nested.push_back(&nestedRoot);
+        }
+        else if (nested.back()->is_array()) {
+            nested.back()->push_back(std::move(value));
+            nested.push_back(&nested.back()->back());
+        }
+        else {
+            json &child = (*nested.back())[nestedKey];
+            child = std::move(value);
+            nested.push_back(&child);
+        }
+        return true;
+    }
+
+    bool endNested() {
+        nested.pop_back();
+        if (nested.empty()) {
+            pushValue(nestedRoot.dump());
+        }
+        return true;
+    }
+
+public:
+    std::string error;
+
+    RecordHandler(std::vector<std::string> &headers, std::vector<Column> &columns,
+        const std::vector<std::string> &categoricalColumns)
+    : headers(headers), columns(columns), categoricalColumns(categoricalColumns), rows(0), depth(0), current(0), expected(0) {
+        for (size_t col = 0; col < headers.size(); ++col) {
+            columnIndex.emplace(headers[col], col);
+        }
+        rows = columns.empty() ? 0 : columns[0].size();
+    }
+
+    bool null() {
+        return nested.empty() ? pushValue("", true) : addNested(nullptr);
+    }
+
+    bool boolean(bool val) {
+        return nested.empty() ? pushValue(val ? "true" : "false") : addNested(val);
+    }
+
+    bool number_integer(json::number_integer_t val) {
+        if (!nested.empty()) {
+            return addNested(val);
+        }
+        char text[24];
+        return pushValue(std::string_view(text, std::to_chars(text, text + sizeof(text), val).ptr - text));
+    }
+
+    bool number_unsigned(json::number_unsigned_t val) {
+        if (!nested.empty()) {
+            return addNested(val);
+        }
+        char text[24];
+        return pushValue(std::string_view(text, std::to_chars(text, text + sizeof(text), val).ptr - text));
+    }
+
+    bool number_float(json::number_float_t val, const json::string_t &text) {
+        return nested.empty() ? pushValue(text) : addNested(val);
+    }
+
+    bool string(json::string_t &val) {
+        return nested.empty() ? pushValue(val) : addNested(std::move(val));
+    }
+
+    bool binary(json::binary_t &) {
+        return true;
+    }
+
+    bool start_object(std::size_t) {
+        ++depth;
+        if (depth == 1) {
+            expected = 0;
+            return true;
+        }
+        return beginNested(json::object());
+    }
+
+    bool key(json::string_t &val) {
+        if (depth == 1) {
+            current = findColumn(val);
+        }
+        else {
+            nestedKey = std::move(val);
+        }
+        return true;
+    }
+
+    bool end_object() {
+        --depth;
+        if (depth > 0) {
+            return endNested();
+        }
+        // Keys missing from the record are nulls
+        ++rows;
+        for (auto &column : columns) {
+            if (column.size() < rows) {
+                column.pushNull();
+            }
+        }
+        return true;
+    }
+
+    bool start_array(std::size_t) {
+        if (depth == 0) {
+            error = "expected a JSON object";
+            return false;
+        }
+        ++depth;
+        return beginNested(json::array());
+    }
+
+    bool end_array() {
+        --depth;
+        return endNested();
+    }
+
+    bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &ex) {
+        error = ex.what();
+        return false;
+    }
+};
+
+JSONLReader::JSONLReader(const std::string &path, const std::vector<std::string> &categoricalColumns)
+: categoricalColumns(categoricalColumns) {
+    auto file = std::make_shared<MappedFile>(path);
+    cursor = file->data();
+    end = file->data() + file->size();
+    owner = file;
+}
+
+void JSONLReader::read(std::vector<std::string> &headers, std::vector<Column> &columns) {
+    headers.clear();
+    columns.clear();
+    RecordHandler handler(headers, columns, categoricalColumns);
+    size_t lineNumber = 0;
+    while (cursor < end) {
+        const char *lineEnd = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+        lineEnd = lineEnd ? lineEnd : end;
+        const char *line = cursor;
+        cursor = lineEnd < end ? lineEnd + 1 : end;
+        ++lineNumber;
+        // Blank lines are skipped
+        if (std::all_of(line, lineEnd, [](char c) { return c == ' ' || c == '\t' || c == '\r'; })) {
+            continue;
+        }
+        if (!json::sax_parse(line, lineEnd, &handler) || !handler.error.empty()) {
+            std::string error = handler.error.empty() ? "expected a JSON object" : handler.error;
+            throw std::runtime_error("invalid JSON on line " + std::to_string(lineNumber) + ": " + error);
+        }
+    }
+}
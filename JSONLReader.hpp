@@ -0,0 +1,28 @@
+#ifndef JSONLREADER_HPP
+#define JSONLREADER_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Column.hpp"
+
+
+// Reads newline-delimited JSON, one object per line, into columns. Lines are
+// parsed with the SAX interface of nlohmann::json, so values go straight into
+// the columns without building a document per line. A column is added for each
+// key on first sight, rows without it hold a null. Nested objects and arrays
+// are kept as their JSON text. Values are stored as text and typed afterwards
+// like CSV cells.
+class JSONLReader {
+private:
+    std::shared_ptr<const void> owner;
+    const char *cursor;
+    const char *end;
+    std::vector<std::string> categoricalColumns;
+
+public:
+    JSONLReader(const std::string &path, const std::vector<std::string> &categoricalColumns = {});
+    void read(std::vector<std::string> &headers, std::vector<Column> &columns);
+};
+
+#endif  // JSONLREADER_HPP
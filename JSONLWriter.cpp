@@ -0,0 +1,102 @@
+#include "JSONLWriter.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+// Appends text as a quoted JSON string
+static void appendString(std::string &buffer, std::string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    buffer += '"';
+    size_t plain = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        buffer.append(text.data() + plain, i - plain);
+        plain = i + 1;
+        buffer += '\\';
+        switch (c) {
+            case '"': buffer += '"'; break;
+            case '\\': buffer += '\\'; break;
+            case '\n': buffer += 'n'; break;
+            case '\r': buffer += 'r'; break;
+            case '\t': buffer += 't'; break;
+            case '\b': buffer += 'b'; break;
+            case '\f': buffer += 'f'; break;
+            default:
+                buffer += "u00";
+                buffer += hex[c >> 4];
+                buffer += hex[c & 15];
+                break;
+        }
+    }
+    buffer.append(text.data() + plain, text.size() - plain);
+    buffer += '"';
+}
+
+JSONLWriter::JSONLWriter(std::ostream &out, const std::vector<std::string> &headers, unsigned threads)
+: out(out), threads(threadCount(threads)) {
+    // Keys are escaped once, with their separators
+    for (size_t col = 0; col < headers.size(); ++col) {
+        std::string key(col == 0 ? "{" : ",");
+        appendString(key, headers[col]);
+        key += ':';
+        keys.push_back(key);
+    }
+}
+
+// Appends the rows in [begin, end) to buffer
+void JSONLWriter::formatRows(std::string &buffer, const std::vector<Column> &columns, size_t begin, size_t end) const {
+    char number[128];
+    for (size_t row = begin; row < end; ++row) {
+        if (columns.empty()) {
+            buffer += '{';
+        }
+        for (size_t col = 0; col < columns.size(); ++col) {
+            buffer += keys[col];
+            const Column &column = columns[col];
+            if (column.isNull(row)) {
+                buffer += "null";
+                continue;
+            }
+            switch (column.getType()) {
+                case ColumnType::Int64:
+                    buffer.append(number, std::to_chars(number, number + sizeof(number), column.intData()[row]).ptr - number);
+                    break;
+                case ColumnType::Double: {
+                    double value = column.doubleData()[row];
+                    if (!std::isfinite(value)) {
+                        buffer += "null";
+                        break;
+                    }
+                    const char *last = writeDouble(number, number + sizeof(number), value, column.getPrecision());
+                    if (last != nullptr) {
+                        buffer.append(number, last - number);
+                    }
+                    else {
+                        buffer += formatDouble(value, column.getPrecision());
+                    }
+                    break;
+                }
+                case ColumnType::Bool:
+                    buffer += column.boolData()[row] ? "true" : "false";
+                    break;
+                case ColumnType::Categorical:
+                    appendString(buffer, column.dictionaryData()[column.codeData()[row]]);
+                    break;
+                default:
+                    appendString(buffer, column.stringData()[row]);
+                    break;
+            }
+        }
+        buffer += "}\n";
+    }
+}
+
+void JSONLWriter::writeRows(const std::vector<Column> &columns, size_t rowCount) {
+    writeBlocks(out, rowCount, threads, [&](std::string &buffer, size_t begin, size_t end) {
+        formatRows(buffer, columns, begin, end);
+    });
+}
@@ -0,0 +1,27 @@
+#ifndef JSONLWRITER_HPP
+#define JSONLWRITER_HPP
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Column.hpp"
+
+
+// Writes columns as newline-delimited JSON, one object per row with the
+// headers as keys. Rows are formatted into large reused buffers like CSVWriter,
+// in parallel blocks with more than one thread. Nulls and non-finite numbers
+// are written as null.
+class JSONLWriter {
+private:
+    std::ostream &out;
+    unsigned threads;
+    std::vector<std::string> keys;
+    void formatRows(std::string &buffer, const std::vector<Column> &columns, size_t begin, size_t end) const;
+
+public:
+    JSONLWriter(std::ostream &out, const std::vector<std::string> &headers, unsigned threads = 1);
+    void writeRows(const std::vector<Column> &columns, size_t rowCount);
+};
+
+#endif  // JSONLWRITER_HPP
@@ -0,0 +1,222 @@
+#include "Predicate.hpp"
+#include "CompareKernels.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+static PredicateOp parseOp(const std::string &op, bool isNumeric) {
+    if (op == "==") return PredicateOp::Equal;
+    if (op == "!=") return PredicateOp::NotEqual;
+    if (isNumeric) {
+        if (op == "<") return PredicateOp::Less;
+        if (op == "<=") return PredicateOp::LessEqual;
+        if (op == ">") return PredicateOp::Greater;
+        if (op == ">=") return PredicateOp::GreaterEqual;
+        if (op == "len") return PredicateOp::Length;
+    }
+    else {
+        if (op == "in") return PredicateOp::Contains;
+        if (op == "or") return PredicateOp::ContainsAny;
+        if (op == "~") return PredicateOp::NotContains;
+        if (op == "startswith") return PredicateOp::StartsWith;
+    }
+    return PredicateOp::Any;
+}
+
+Predicate::Predicate(const std::string &column, const std::string &op, const std::string &value)
+: column(column), op(parseOp(op, false)), text(value), number(0), isNumeric(false) {
+    if (this->op == PredicateOp::NotEqual || this->op == PredicateOp::ContainsAny) {
+        values = splitStr(value, ',');
+    }
+    if (this->op == PredicateOp::ContainsAny && values.size() > 1) {
+        matcher = std::make_shared<StringMatcher>(values);
+    }
+}
+
+Predicate::Predicate(const std::string &column, const std::string &op, double value)
+: column(column), op(parseOp(op, true)), number(value), isNumeric(true) {
+    //
+}
+
+// Tests a cell given as text, an empty cell being null. Numeric operators
+// parse the cell and reject nulls and text that is not a number.
+bool Predicate::matches(std::string_view data) const {
+    if (!isNumeric) {
+        return matchesText(data);
+    }
+    if (op == PredicateOp::Length) {
+        return data.size() == static_cast<size_t>(static_cast<int>(number));
+    }
+    double value;
+    bool flag;
+    if (parseDouble(data, value)) {
+        return matchesNumber(value);
+    }
+    if (parseBool(data, flag)) {
+        return matchesNumber(flag ? 1. : 0.);
+    }
+    return false;
+}
+
+// != rejects every value of its list, or accepts any value of its list found
+// in the cell
+bool Predicate::matchesText(std::string_view data) const {
+    switch (op) {
+        case PredicateOp::Equal:
+            return data == text;
+        case PredicateOp::NotEqual:
+            for (const auto &value : values) {
+                if (data == value) {
+                    return false;
+                }
+            }
+            return true;
+        case PredicateOp::Contains:
+            return data.find(text) != std::string_view::npos;
+        case PredicateOp::ContainsAny:
+            if (matcher) {
+                return matcher->containsAny(data);
+            }
+            for (const auto &value : values) {
+                if (data.find(value) != std::string_view::npos) {
+                    return true;
+                }
+            }
+            return false;
+        case PredicateOp::NotContains:
+            return data.find(text) == std::string_view::npos;
+        case PredicateOp::StartsWith:
+            return data.substr(0, text.size()) == text;
+        default:
+            return true;
+    }
+}
+
+bool Predicate::matchesNumber(double data) const {
+    switch (op) {
+        case PredicateOp::Equal: return data == number;
+        case PredicateOp::NotEqual: return data != number;
+        case PredicateOp::Less: return data < number;
+        case PredicateOp::LessEqual: return data <= number;
+        case PredicateOp::Greater: return data > number;
+        case PredicateOp::GreaterEqual: return data >= number;
+        default: return true;
+    }
+}
+
+// Numbers compared with a cell that holds text, which must be numeric
+static double textNumber(std::string_view data) {
+    double value;
+    if (!parseDouble(data, value)) {
+        throw std::invalid_argument("not a number: " + std::string(data));
+    }
+    return value;
+}
+
+// Sets bit i - begin of mask for each row i in [begin, end) of data that
+// matches, the layout of the column validity bitmap; begin is a multiple of 64
+// and the bits past end are cleared. Int64 and Double columns go through the
+// SIMD compare kernels. Categorical cells are tested once per dictionary entry,
+// the results kept in codeResults across calls. Numeric operators skip nulls,
+// text operators see them as empty strings.
+void Predicate::evaluate(const Column &data, size_t begin, size_t end, uint64_t *mask,
+    std::vector<int8_t> &codeResults) const {
+    const size_t count = end - begin;
+    const size_t words = (count + 63) / 64;
+    std::fill(mask, mask + words, 0);
+    const bool isLength = isNumeric && op == PredicateOp::Length;
+    const int length = static_cast<int>(number);
+    auto setBit = [mask, begin](size_t row) {
+        mask[(row - begin) / 64] |= 1ULL << ((row - begin) % 64);
+    };
+    if (isNumeric && !isLength && (data.isNumeric() || data.getType() == ColumnType::Bool)) {
+        if (op == PredicateOp::Any) {
+            std::fill(mask, mask + words, ~0ULL);
+            if (count % 64 != 0) {
+                mask[words - 1] = (1ULL << (count % 64)) - 1;
+            }
+        }
+        else if (data.getType() == ColumnType::Int64) {
+            compareInts(data.intData().data() + begin, count, op, number, mask);
+        }
+        else if (data.getType() == ColumnType::Double) {
+            compareDoubles(data.doubleData().data() + begin, count, op, number, mask);
+        }
+        else {
+            const std::vector<uint8_t> &bools = data.boolData();
+            for (size_t row = begin; row < end; ++row) {
+                if (matchesNumber(bools[row])) {
+                    setBit(row);
+                }
+            }
+        }
+        // Nulls are cleared with the validity bitmap, which has the same layout
+        const std::vector<uint64_t> &validity = data.validityData();
+        if (data.nullCount() > 0) {
+            for (size_t w = 0; w < words && begin / 64 + w < validity.size(); ++w) {
+                mask[w] &= validity[begin / 64 + w];
+            }
+        }
+        return;
+    }
+    auto testCell = [&](std::string_view cell, bool isNull) {
+        if (isLength) {
+            return cell.size() == static_cast<size_t>(length);
+        }
+        if (isNumeric) {
+            return !isNull && matchesNumber(textNumber(cell));
+        }
+        return matchesText(cell);
+    };
+    switch (data.getType()) {
+        case ColumnType::String: {
+            const std::vector<std::string_view> &strings = data.stringData();
+            for (size_t row = begin; row < end; ++row) {
+                if (testCell(strings[row], strings[row].empty())) {
+                    setBit(row);
+                }
+            }
+            break;
+        }
+        case ColumnType::Categorical: {
+            // Each code is tested on first sight, -1 being null
+            const std::vector<std::string_view> &dictionary = data.dictionaryData();
+            const std::vector<int32_t> &codes = data.codeData();
+            const bool hasNulls = data.nullCount() > 0;
+            if (codeResults.size() != dictionary.size() + 1) {
+                codeResults.assign(dictionary.size() + 1, -1);
+            }
+            for (size_t row = begin; row < end; ++row) {
+                int32_t code = hasNulls && data.isNull(row) ? -1 : codes[row];
+                int8_t &known = codeResults[code + 1];
+                if (known < 0) {
+                    known = code < 0 ? testCell(std::string_view(), true) : testCell(dictionary[code], false);
+                }
+                if (known) {
+                    setBit(row);
+                }
+            }
+            break;
+        }
+        default:
+            for (size_t row = begin; row < end; ++row) {
+                if (testCell(data.get(row), data.isNull(row))) {
+                    setBit(row);
+                }
+            }
+            break;
+    }
+}
+
+void Predicate::evaluate(const Column &data, size_t rowCount, std::vector<uint64_t> &mask) const {
+    std::vector<int8_t> codeResults;
+    mask.resize((rowCount + 63) / 64);
+    evaluate(data, 0, rowCount, mask.data(), codeResults);
+}
+
+// Appends to kept the rows of data that match, in order
+void Predicate::select(const Column &data, size_t rowCount, std::vector<size_t> &kept) const {
+    std::vector<uint64_t> mask;
+    evaluate(data, rowCount, mask);
+    appendSelection(mask.data(), rowCount, kept);
+}
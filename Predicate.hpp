@@ -0,0 +1,51 @@
+#ifndef PREDICATE_HPP
+#define PREDICATE_HPP
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Column.hpp"
+#include "StringMatcher.hpp"
+
+enum class PredicateOp {
+    Equal,
+    NotEqual,
+    Contains,
+    ContainsAny,
+    NotContains,
+    StartsWith,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+    Length,
+    Any
+};
+
+// A column compared with a constant, using the operators of filterRows.
+// String constants take ==, !=, in, or, ~ and startswith, numeric constants
+// take ==, !=, <, <=, >, >= and len. Unknown operators match every row.
+// The operator is resolved once on construction and the comma separated lists
+// of != and or are split up front, so testing a row does no string dispatch.
+// An or list of several values is compiled into a StringMatcher, testing a
+// cell against all of them in one pass over the cell.
+struct Predicate {
+    std::string column;
+    PredicateOp op;
+    std::string text;
+    std::vector<std::string> values;
+    std::shared_ptr<const StringMatcher> matcher;
+    double number;
+    bool isNumeric;
+    Predicate(const std::string &column, const std::string &op, const std::string &value);
+    Predicate(const std::string &column, const std::string &op, double value);
+    bool matches(std::string_view data) const;
+    bool matchesText(std::string_view data) const;
+    bool matchesNumber(double data) const;
+    void evaluate(const Column &data, size_t begin, size_t end, uint64_t *mask, std::vector<int8_t> &codeResults) const;
+    void evaluate(const Column &data, size_t rowCount, std::vector<uint64_t> &mask) const;
+    void select(const Column &data, size_t rowCount, std::vector<size_t> &kept) const;
+};
+
+#endif  // PREDICATE_HPP
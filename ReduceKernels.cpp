@@ -0,0 +1,528 @@
+#include "ReduceKernels.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define REDUCE_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+// Integers are summed exactly as three unsigned totals, of the low 32 bits, of
+// the high 32 bits and of the negative values; none of them overflows below
+// 2^30 values
+struct IntParts {
+    uint64_t low = 0;
+    uint64_t high = 0;
+    uint64_t negatives = 0;
+};
+
+static const size_t intChunkBlocks = size_t(1) << 24;
+
+typedef double (*SumKernel)(const double *values, size_t blocks, const uint64_t *validity);
+typedef void (*CompensatedKernel)(const double *values, size_t blocks, const uint64_t *validity,
+    double &sum, double &correction);
+typedef void (*IntSumKernel)(const int64_t *values, size_t blocks, const uint64_t *validity, IntParts &parts);
+typedef void (*DoubleMinMaxKernel)(const double *values, size_t blocks, const uint64_t *validity,
+    double &min, double &max);
+typedef void (*IntMinMaxKernel)(const int64_t *values, size_t blocks, const uint64_t *validity,
+    int64_t &min, int64_t &max);
+typedef double (*DeviationKernel)(const double *values, size_t blocks, const uint64_t *validity, double mean);
+
+// Block sums added as a binary counter: levels[k] holds the sum of 2^k blocks
+// when bit k of count is set
+struct PairwiseSum {
+    double levels[64];
+    uint64_t count = 0;
+
+    void add(double value) {
+        size_t k = 0;
+        for (uint64_t c = count; c & 1; c >>= 1) {
+            value = levels[k++] + value;
+        }
+        levels[k] = value;
+        ++count;
+    }
+
+    double total() const {
+        double sum = 0;
+        for (size_t k = 0; k < 64; ++k) {
+            if (count >> k & 1) {
+                sum += levels[k];
+            }
+        }
+        return sum;
+    }
+};
+
+static inline uint64_t blockWord(const uint64_t *validity, size_t block) {
+    return validity ? validity[block] : ~0ULL;
+}
+
+// Neumaier step: sum + value with the rounding error added to correction
+static inline void compensatedAdd(double &sum, double &correction, double value) {
+    double t = sum + value;
+    if (std::fabs(sum) >= std::fabs(value)) {
+        correction += (sum - t) + value;
+    }
+    else {
+        correction += (value - t) + sum;
+    }
+    sum = t;
+}
+
+// The scalar code works on up to 64 values whose valid bits are in word
+template<typename Value>
+static double scalarSum(const Value *p, size_t count, uint64_t word) {
+    double acc[4] = {0, 0, 0, 0};
+    for (size_t i = 0; i < count; ++i) {
+        if (word >> i & 1) {
+            acc[i % 4] += p[i];
+        }
+    }
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+static double scalarDeviations(const double *p, size_t count, uint64_t word, double mean) {
+    double acc[4] = {0, 0, 0, 0};
+    for (size_t i = 0; i < count; ++i) {
+        if (word >> i & 1) {
+            double d = p[i] - mean;
+            acc[i % 4] += d * d;
+        }
+    }
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+static void scalarCompensated(const double *p, size_t count, uint64_t word, double &sum, double &correction) {
+    for (size_t i = 0; i < count; ++i) {
+        if (word >> i & 1) {
+            compensatedAdd(sum, correction, p[i]);
+        }
+    }
+}
+
+static void scalarIntParts(const int64_t *p, size_t count, uint64_t word, IntParts &parts) {
+    for (size_t i = 0; i < count; ++i) {
+        if (word >> i & 1) {
+            uint64_t v = static_cast<uint64_t>(p[i]);
+            parts.low += v & 0xffffffffULL;
+            parts.high += v >> 32;
+            parts.negatives += p[i] < 0;
+        }
+    }
+}
+
+// NaN fails both comparisons and is skipped
+template<typename Value>
+static void scalarMinMax(const Value *p, size_t count, uint64_t word, Value &min, Value &max) {
+    for (size_t i = 0; i < count; ++i) {
+        if (word >> i & 1) {
+            if (p[i] < min) min = p[i];
+            if (p[i] > max) max = p[i];
+        }
+    }
+}
+
+static double scalarSumDoubles(const double *values, size_t blocks, const uint64_t *validity) {
+    PairwiseSum pairwise;
+    for (size_t b = 0; b < blocks; ++b) {
+        pairwise.add(scalarSum(values + b * 64, 64, blockWord(validity, b)));
+    }
+    return pairwise.total();
+}
+
+static void scalarCompensatedDoubles(const double *values, size_t blocks, const uint64_t *validity,
+    double &sum, double &correction) {
+    for (size_t b = 0; b < blocks; ++b) {
+        scalarCompensated(values + b * 64, 64, blockWord(validity, b), sum, correction);
+    }
+}
+
+static void scalarSumInts(const int64_t *values, size_t blocks, const uint64_t *validity, IntParts &parts) {
+    for (size_t b = 0; b < blocks; ++b) {
+        scalarIntParts(values + b * 64, 64, blockWord(validity, b), parts);
+    }
+}
+
+static void scalarMinMaxDoubles(const double *values, size_t blocks, const uint64_t *validity,
+    double &min, double &max) {
+    for (size_t b = 0; b < blocks; ++b) {
+        scalarMinMax(values + b * 64, 64, blockWord(validity, b), min, max);
+    }
+}
+
+static void scalarMinMaxInts(const int64_t *values, size_t blocks, const uint64_t *validity,
+    int64_t &min, int64_t &max) {
+    for (size_t b = 0; b < blocks; ++b) {
+        scalarMinMax(values + b * 64, 64, blockWord(validity, b), min, max);
+    }
+}
+
+static double scalarDeviationDoubles(const double *values, size_t blocks, const uint64_t *validity, double mean) {
+    PairwiseSum pairwise;
+    for (size_t b = 0; b < blocks; ++b) {
+        pairwise.add(scalarDeviations(values + b * 64, 64, blockWord(validity, b), mean));
+    }
+    return pairwise.total();
+}
+
+#ifdef REDUCE_X86
+// All ones in lane j when bit j of the low 4 bits of word is set
+TARGET_AVX2 static inline __m256i laneMask(uint64_t word) {
+    const __m256i bits = _mm256_set_epi64x(8, 4, 2, 1);
+    return _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(word & 15), bits), bits);
+}
+
+TARGET_AVX2 static inline __m256d maskedLoad(const double *p, uint64_t word) {
+    return _mm256_and_pd(_mm256_loadu_pd(p), _mm256_castsi256_pd(laneMask(word)));
+}
+
+TARGET_AVX2 static inline double horizontalSum(__m256d v) {
+    __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+// Four accumulators of four lanes each hide the latency of the additions.
+// Nulls are masked to 0 rather than multiplied, which would keep NaN.
+TARGET_AVX2 static double avx2SumDoubles(const double *values, size_t blocks, const uint64_t *validity) {
+    PairwiseSum pairwise;
+    for (size_t b = 0; b < blocks; ++b) {
+        const double *p = values + b * 64;
+        const uint64_t word = blockWord(validity, b);
+        if (word == 0) {
+            continue;
+        }
+        __m256d a0 = _mm256_setzero_pd(), a1 = a0, a2 = a0, a3 = a0;
+        if (word == ~0ULL) {
+            for (int i = 0; i < 64; i += 16) {
+                a0 = _mm256_add_pd(a0, _mm256_loadu_pd(p + i));
+                a1 = _mm256_add_pd(a1, _mm256_loadu_pd(p + i + 4));
+                a2 = _mm256_add_pd(a2, _mm256_loadu_pd(p + i + 8));
+                a3 = _mm256_add_pd(a3, _mm256_loadu_pd(p + i + 12));
+            }
+        }
+        else {
+            for (int i = 0; i < 64; i += 16) {
+                a0 = _mm256_add_pd(a0, maskedLoad(p + i, word >> i));
+                a1 = _mm256_add_pd(a1, maskedLoad(p + i + 4, word >> (i + 4)));
+                a2 = _mm256_add_pd(a2, maskedLoad(p + i + 8, word >> (i + 8)));
+                a3 = _mm256_add_pd(a3, maskedLoad(p + i + 12, word >> (i + 12)));
+            }
+        }
+        pairwise.add(horizontalSum(_mm256_add_pd(_mm256_add_pd(a0, a1), _mm256_add_pd(a2, a3))));
+    }
+    return pairwise.total();
+}
+
+// compensatedAdd on each lane, the branch replaced by a blend
+TARGET_AVX2 static inline void compensatedAdd(__m256d &sum, __m256d &correction, __m256d value) {
+    const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+    __m256d t = _mm256_add_pd(sum, value);
+    __m256d sumLarger = _mm256_cmp_pd(_mm256_and_pd(sum, absMask), _mm256_and_pd(value, absMask), _CMP_GE_OQ);
+    __m256d fromSum = _mm256_add_pd(_mm256_sub_pd(sum, t), value);
+    __m256d fromValue = _mm256_add_pd(_mm256_sub_pd(value, t), sum);
+    correction = _mm256_add_pd(correction, _mm256_blendv_pd(fromValue, fromSum, sumLarger));
+    sum = t;
+}
+
+TARGET_AVX2 static void avx2CompensatedDoubles(const double *values, size_t blocks, const uint64_t *validity,
+    double &sum, double &correction) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = s0, c0 = s0, c1 = s0;
+    for (size_t b = 0; b < blocks; ++b) {
+        const double *p = values + b * 64;
+        const uint64_t word = blockWord(validity, b);
+        if (word == ~0ULL) {
+            for (int i = 0; i < 64; i += 8) {
+                compensatedAdd(s0, c0, _mm256_loadu_pd(p + i));
+                compensatedAdd(s1, c1, _mm256_loadu_pd(p + i + 4));
+            }
+        }
+        else if (word != 0) {
+            for (int i = 0; i < 64; i += 8) {
+                compensatedAdd(s0, c0, maskedLoad(p + i, word >> i));
+                compensatedAdd(s1, c1, maskedLoad(p + i + 4, word >> (i + 4)));
+            }
+        }
+    }
+    double lanes[8], corrections[8];
+    _mm256_storeu_pd(lanes, s0);
+    _mm256_storeu_pd(lanes + 4, s1);
+    _mm256_storeu_pd(corrections, c0);
+    _mm256_storeu_pd(corrections + 4, c1);
+    for (int i = 0; i < 8; ++i) {
+        compensatedAdd(sum, correction, lanes[i]);
+        correction += corrections[i];
+    }
+}
+
+TARGET_AVX2 static void avx2SumInts(const int64_t *values, size_t blocks, const uint64_t *validity, IntParts &parts) {
+    const __m256i lowMask = _mm256_set1_epi64x(0xffffffffLL);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i low = zero, high = zero, negatives = zero;
+    for (size_t b = 0; b < blocks; ++b) {
+        const int64_t *p = values + b * 64;
+        const uint64_t word = blockWord(validity, b);
+        if (word == 0) {
+            continue;
+        }
+        for (int i = 0; i < 64; i += 4) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+            if (word != ~0ULL) {
+                v = _mm256_and_si256(v, laneMask(word >> i));
+            }
+            low = _mm256_add_epi64(low, _mm256_and_si256(v, lowMask));
+            high = _mm256_add_epi64(high, _mm256_srli_epi64(v, 32));
+            negatives = _mm256_sub_epi64(negatives, _mm256_cmpgt_epi64(zero, v));
+        }
+    }
+    uint64_t lanes[12];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), low);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes + 4), high);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes + 8), negatives);
+    for (int i = 0; i < 4; ++i) {
+        parts.low += lanes[i];
+        parts.high += lanes[i + 4];
+        parts.negatives += lanes[i + 8];
+    }
+}
+
+// Nulls are blended to the infinity that leaves each accumulator unchanged.
+// min_pd and max_pd return their second operand when the first is NaN, so
+// NaN values never reach the accumulators.
+TARGET_AVX2 static void avx2MinMaxDoubles(const double *values, size_t blocks, const uint64_t *validity,
+    double &min, double &max) {
+    const __m256d positive = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    const __m256d negative = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+    __m256d mn0 = _mm256_set1_pd(min), mn1 = mn0, mx0 = _mm256_set1_pd(max), mx1 = mx0;
+    for (size_t b = 0; b < blocks; ++b) {
+        const double *p = values + b * 64;
+        const uint64_t word = blockWord(validity, b);
+        if (word == ~0ULL) {
+            for (int i = 0; i < 64; i += 8) {
+                __m256d v0 = _mm256_loadu_pd(p + i), v1 = _mm256_loadu_pd(p + i + 4);
+                mn0 = _mm256_min_pd(v0, mn0);
+                mn1 = _mm256_min_pd(v1, mn1);
+                mx0 = _mm256_max_pd(v0, mx0);
+                mx1 = _mm256_max_pd(v1, mx1);
+            }
+        }
+        else if (word != 0) {
+            for (int i = 0; i < 64; i += 4) {
+                __m256d v = _mm256_loadu_pd(p + i);
+                __m256d valid = _mm256_castsi256_pd(laneMask(word >> i));
+                mn0 = _mm256_min_pd(_mm256_blendv_pd(positive, v, valid), mn0);
+                mx0 = _mm256_max_pd(_mm256_blendv_pd(negative, v, valid), mx0);
+            }
+        }
+    }
+    double mins[4], maxs[4];
+    _mm256_storeu_pd(mins, _mm256_min_pd(mn0, mn1));
+    _mm256_storeu_pd(maxs, _mm256_max_pd(mx0, mx1));
+    for (int i = 0; i < 4; ++i) {
+        if (mins[i] < min) min = mins[i];
+        if (maxs[i] > max) max = maxs[i];
+    }
+}
+
+TARGET_AVX2 static void avx2MinMaxInts(const int64_t *values, size_t blocks, const uint64_t *validity,
+    int64_t &min, int64_t &max) {
+    const __m256i largest = _mm256_set1_epi64x(std::numeric_limits<int64_t>::max());
+    const __m256i smallest = _mm256_set1_epi64x(std::numeric_limits<int64_t>::min());
+    __m256i mn = _mm256_set1_epi64x(min), mx = _mm256_set1_epi64x(max);
+    for (size_t b = 0; b < blocks; ++b) {
+        const int64_t *p = values + b * 64;
+        const uint64_t word = blockWord(validity, b);
+        if (word == 0) {
+            continue;
+        }
+        for (int i = 0; i < 64; i += 4) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+            __m256i low = v, high = v;
+            if (word != ~0ULL) {
+                __m256i valid = laneMask(word >> i);
+                low = _mm256_blendv_epi8(largest, v, valid);
+                high = _mm256_blendv_epi8(smallest, v, valid);
+            }
+            mn = _mm256_blendv_epi8(mn, low, _mm256_cmpgt_epi64(mn, low));
+            mx = _mm256_blendv_epi8(mx, high, _mm256_cmpgt_epi64(high, mx));
+        }
+    }
+    int64_t mins[4], maxs[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(mins), mn);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(maxs), mx);
+    for (int i = 0; i < 4; ++i) {
+        if (mins[i] < min) min = mins[i];
+        if (maxs[i] > max) max = maxs[i];
+    }
+}
+
+TARGET_AVX2 static double avx2DeviationDoubles(const double *values, size_t blocks, const uint64_t *validity,
+    double mean) {
+    const __m256d m = _mm256_set1_pd(mean);
+    PairwiseSum pairwise;
+    for (size_t b = 0; b < blocks; ++b) {
+        const double *p = values + b * 64;
+        const uint64_t word = blockWord(validity, b);
+        if (word == 0) {
+            continue;
+        }
+        __m256d a0 = _mm256_setzero_pd(), a1 = a0;
+        for (int i = 0; i < 64; i += 8) {
+            __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(p + i), m);
+            __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(p + i + 4), m);
+            if (word != ~0ULL) {
+                d0 = _mm256_and_pd(d0, _mm256_castsi256_pd(laneMask(word >> i)));
+                d1 = _mm256_and_pd(d1, _mm256_castsi256_pd(laneMask(word >> (i + 4))));
+            }
+            a0 = _mm256_add_pd(a0, _mm256_mul_pd(d0, d0));
+            a1 = _mm256_add_pd(a1, _mm256_mul_pd(d1, d1));
+        }
+        pairwise.add(horizontalSum(_mm256_add_pd(a0, a1)));
+    }
+    return pairwise.total();
+}
+#endif
+
+template<typename Kernel>
+static Kernel selectKernel(Kernel avx2, Kernel scalar) {
+#ifdef REDUCE_X86
+    if (cpuHasAVX2()) {
+        return avx2;
+    }
+#else
+    (void)avx2;
+#endif
+    return scalar;
+}
+
+#ifdef REDUCE_X86
+#define REDUCE_KERNEL(name) selectKernel(avx2##name, scalar##name)
+#else
+#define REDUCE_KERNEL(name) selectKernel(scalar##name, scalar##name)
+#endif
+
+static const SumKernel sumKernel = REDUCE_KERNEL(SumDoubles);
+static const CompensatedKernel compensatedKernel = REDUCE_KERNEL(CompensatedDoubles);
+static const IntSumKernel intSumKernel = REDUCE_KERNEL(SumInts);
+static const DoubleMinMaxKernel doubleMinMaxKernel = REDUCE_KERNEL(MinMaxDoubles);
+static const IntMinMaxKernel intMinMaxKernel = REDUCE_KERNEL(MinMaxInts);
+static const DeviationKernel deviationKernel = REDUCE_KERNEL(DeviationDoubles);
+
+// Valid bits of the last, partial block
+static uint64_t tailWord(const uint64_t *validity, size_t count) {
+    return blockWord(validity, count / 64) & ((1ULL << (count % 64)) - 1);
+}
+
+double sumDoubles(const double *values, size_t count, const uint64_t *validity, bool compensated) {
+    const size_t blocks = count / 64;
+    const double *tail = values + blocks * 64;
+    if (compensated) {
+        double sum = 0;
+        double correction = 0;
+        compensatedKernel(values, blocks, validity, sum, correction);
+        if (count % 64 != 0) {
+            scalarCompensated(tail, count % 64, tailWord(validity, count), sum, correction);
+        }
+        // The correction of an infinite sum is NaN
+        return std::isfinite(sum) ? sum + correction : sum;
+    }
+    double sum = sumKernel(values, blocks, validity);
+    if (count % 64 != 0) {
+        sum += scalarSum(tail, count % 64, tailWord(validity, count));
+    }
+    return sum;
+}
+
+static bool addInts(int64_t a, int64_t b, int64_t &sum) {
+    if ((b > 0 && a > std::numeric_limits<int64_t>::max() - b) ||
+        (b < 0 && a < std::numeric_limits<int64_t>::min() - b)) {
+        return false;
+    }
+    sum = a + b;
+    return true;
+}
+
+// The chunk sum is (high - 2^32 negatives) * 2^32 + low; it fits an int64_t
+// when its upper part, carry of low included, fits 32 bits
+static bool foldParts(const IntParts &parts, int64_t &sum) {
+    int64_t upper = static_cast<int64_t>(parts.high) - static_cast<int64_t>(parts.negatives << 32)
+        + static_cast<int64_t>(parts.low >> 32);
+    if (upper < std::numeric_limits<int32_t>::min() || upper > std::numeric_limits<int32_t>::max()) {
+        return false;
+    }
+    sum = static_cast<int64_t>(static_cast<uint64_t>(upper) << 32 | (parts.low & 0xffffffffULL));
+    return true;
+}
+
+bool sumInts(const int64_t *values, size_t count, const uint64_t *validity, int64_t &sum) {
+    const size_t blocks = count / 64;
+    sum = 0;
+    size_t b = 0;
+    do {
+        IntParts parts;
+        size_t chunk = std::min(intChunkBlocks, blocks - b);
+        intSumKernel(values + b * 64, chunk, validity ? validity + b : nullptr, parts);
+        b += chunk;
+        if (b == blocks && count % 64 != 0) {
+            scalarIntParts(values + blocks * 64, count % 64, tailWord(validity, count), parts);
+        }
+        int64_t chunkSum;
+        if (!foldParts(parts, chunkSum) || !addInts(sum, chunkSum, sum)) {
+            return false;
+        }
+    } while (b < blocks);
+    return true;
+}
+
+bool minMaxDoubles(const double *values, size_t count, const uint64_t *validity, double &min, double &max) {
+    const size_t blocks = count / 64;
+    min = std::numeric_limits<double>::infinity();
+    max = -std::numeric_limits<double>::infinity();
+    doubleMinMaxKernel(values, blocks, validity, min, max);
+    if (count % 64 != 0) {
+        scalarMinMax(values + blocks * 64, count % 64, tailWord(validity, count), min, max);
+    }
+    return min <= max;
+}
+
+bool minMaxInts(const int64_t *values, size_t count, const uint64_t *validity, int64_t &min, int64_t &max) {
+    const size_t blocks = count / 64;
+    min = std::numeric_limits<int64_t>::max();
+    max = std::numeric_limits<int64_t>::min();
+    intMinMaxKernel(values, blocks, validity, min, max);
+    if (count % 64 != 0) {
+        scalarMinMax(values + blocks * 64, count % 64, tailWord(validity, count), min, max);
+    }
+    return validCount(count, validity) > 0;
+}
+
+double squaredDeviations(const double *values, size_t count, const uint64_t *validity, double mean) {
+    const size_t blocks = count / 64;
+    double sum = deviationKernel(values, blocks, validity, mean);
+    if (count % 64 != 0) {
+        sum += scalarDeviations(values + blocks * 64, count % 64, tailWord(validity, count), mean);
+    }
+    return sum;
+}
+
+size_t validCount(size_t count, const uint64_t *validity) {
+    if (!validity) {
+        return count;
+    }
+    size_t valid = 0;
+    for (size_t b = 0; b < count / 64; ++b) {
+        valid += popCount(validity[b]);
+    }
+    if (count % 64 != 0) {
+        valid += popCount(tailWord(validity, count));
+    }
+    return valid;
+}
@@ -0,0 +1,33 @@
+#ifndef REDUCEKERNELS_HPP
+#define REDUCEKERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+
+// Reductions over a typed column. validity is the column validity bitmap (bit
+// i % 64 of word i / 64 set when value i is valid), or nullptr when every value
+// is valid; null values are skipped whatever they hold. The AVX2 kernels are
+// chosen at runtime when the CPU has them, with scalar code as the fallback.
+
+// Sum of the valid values, 0 when there are none. Values are added in 64-value
+// blocks over several accumulators and the block sums are added pairwise, so
+// the rounding error grows with log(count). compensated keeps a Neumaier
+// correction term per accumulator instead, which is exact to the last bit for
+// most inputs at a higher cost. NaN in the input gives NaN.
+double sumDoubles(const double *values, size_t count, const uint64_t *validity, bool compensated = false);
+
+// Exact sum of the valid values, false when it does not fit an int64_t
+bool sumInts(const int64_t *values, size_t count, const uint64_t *validity, int64_t &sum);
+
+// Smallest and largest valid value, NaN being skipped; false when there is none
+bool minMaxDoubles(const double *values, size_t count, const uint64_t *validity, double &min, double &max);
+bool minMaxInts(const int64_t *values, size_t count, const uint64_t *validity, int64_t &min, int64_t &max);
+
+// Sum of (value - mean)^2 over the valid values, added pairwise as in sumDoubles
+double squaredDeviations(const double *values, size_t count, const uint64_t *validity, double mean);
+
+// Number of valid values
+size_t validCount(size_t count, const uint64_t *validity);
+
+#endif  // REDUCEKERNELS_HPP
@@ -0,0 +1,183 @@
+#include "SortedGroupBy.hpp"
+#include <stdexcept>
+
+// Means are kept as a sum and a count, the sum being op i and the count op
+// i + 1, so that partial results add up across batches
+SortedGroupBy::SortedGroupBy(const std::vector<std::string> &keys, const std::vector<Aggregation> &aggregations)
+: keyNames(keys), aggregations(aggregations), direction(0), isOpen(false) {
+    for (const Aggregation &aggregation : aggregations) {
+        if (aggregation.op == AggregateOp::Mean) {
+            ops.push_back(AggregateOp::Sum);
+            ops.push_back(AggregateOp::Count);
+        }
+        else {
+            ops.push_back(aggregation.op);
+        }
+    }
+}
+
+// How two partial results of a group combine
+static AggregateOp combineOp(AggregateOp op) {
+    return op == AggregateOp::Count ? AggregateOp::Sum : op;
+}
+
+// A one row copy of a cell that holds its own text, so that the open group
+// does not keep the buffers of past batches alive
+static Column detachCell(const Column &column, size_t row) {
+    Column cell(column.getType());
+    cell.setPrecision(column.getPrecision());
+    if (column.isNull(row)) {
+        cell.pushNull();
+        return cell;
+    }
+    switch (column.getType()) {
+        case ColumnType::Int64: cell.pushInt(column.getInt(row)); break;
+        case ColumnType::Double: cell.pushDouble(column.getDouble(row)); break;
+        case ColumnType::Bool: cell.pushBool(column.getBool(row)); break;
+        default: cell.push_back(column.get(row)); break;
+    }
+    return cell;
+}
+
+// Sets groups to the first count rows of the key and partial value columns
+void SortedGroupBy::emit(std::vector<Column> &keys, std::vector<Column> &values, size_t count, Dataframe &groups) const {
+    std::vector<size_t> rows(count);
+    for (size_t i = 0; i < count; ++i) {
+        rows[i] = i;
+    }
+    groups.headers = keyNames;
+    groups.columns.clear();
+    groups.rowCount = count;
+    for (const Column &key : keys) {
+        groups.columns.push_back(key.copyRows(rows));
+    }
+    size_t op = 0;
+    for (const Aggregation &aggregation : aggregations) {
+        groups.headers.push_back(aggregation.name);
+        if (aggregation.op != AggregateOp::Mean) {
+            groups.columns.push_back(values[op++].copyRows(rows));
+            continue;
+        }
+        const Column &sums = values[op++];
+        const Column &counts = values[op++];
+        Column means(ColumnType::Double);
+        means.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            if (sums.isNull(i)) {
+                means.pushNull();
+            }
+            else {
+                means.pushDouble(sums.getDouble(i) / static_cast<double>(counts.getInt(i)));
+            }
+        }
+        groups.columns.push_back(std::move(means));
+    }
+}
+
+// Sets groups to the groups completed by batch, which must carry on the key
+// order of the earlier batches. Throws std::runtime_error when the keys are
+// out of order and std::out_of_range for a missing column.
+void SortedGroupBy::add(Dataframe &batch, Dataframe &groups) {
+    std::vector<const Column *> keys;
+    for (const std::string &name : keyNames) {
+        keys.push_back(&batch.getColumnData(name));
+    }
+    std::vector<const Column *> values;
+    for (const Aggregation &aggregation : aggregations) {
+        const Column *column = &batch.getColumnData(aggregation.column);
+        values.push_back(column);
+        if (aggregation.op == AggregateOp::Mean) {
+            values.push_back(column);
+        }
+    }
+    std::vector<uint32_t> groupIds;
+    std::vector<size_t> firstRows;
+    if (!findRuns(keys, batch.rowCount, direction, groupIds, firstRows)) {
+        throw std::runtime_error("input is not sorted on the group keys");
+    }
+    std::vector<Column> batchKeys;
+    std::vector<Column> batchValues;
+    for (const Column *key : keys) {
+        batchKeys.push_back(key->copyRows(firstRows));
+    }
+    for (size_t i = 0; i < ops.size(); ++i) {
+        Aggregator aggregator(*values[i], ops[i]);
+        aggregator.update(groupIds.data(), 0, batch.rowCount, firstRows.size());
+        batchValues.push_back(aggregator.finish(firstRows));
+    }
+    size_t groupCount = firstRows.size();
+
+    // The open group either goes on in the first group of the batch, its
+    // partial results then combined, or ends before it
+    if (isOpen && groupCount > 0) {
+        std::vector<const Column *> open;
+        std::vector<const Column *> first;
+        for (size_t k = 0; k < keys.size(); ++k) {
+            open.push_back(&openKeys[k]);
+            first.push_back(&batchKeys[k]);
+        }
+        int order = compareKeys(open, 0, first, 0);
+        if (order != 0) {
+            int step = order < 0 ? 1 : -1;
+            if (direction != 0 && step != direction) {
+                throw std::runtime_error("input is not sorted on the group keys");
+            }
+            direction = step;
+        }
+        std::vector<uint32_t> combinedIds(groupCount + 1);
+        std::vector<size_t> combinedRows(groupCount + (order != 0 ? 1 : 0));
+        for (size_t g = 0; g <= groupCount; ++g) {
+            combinedIds[g] = static_cast<uint32_t>(order != 0 ? g : (g == 0 ? 0 : g - 1));
+        }
+        for (size_t g = 0; g < combinedRows.size(); ++g) {
+            combinedRows[g] = order != 0 ? g : (g == 0 ? 0 : g + 1);
+        }
+        for (size_t k = 0; k < keys.size(); ++k) {
+            Column combined(openKeys[k]);
+            combined.append(batchKeys[k]);
+            combined.select(combinedRows);
+            batchKeys[k] = std::move(combined);
+        }
+        for (size_t i = 0; i < ops.size(); ++i) {
+            Column partials(openValues[i]);
+            partials.append(batchValues[i]);
+            Aggregator aggregator(partials, combineOp(ops[i]));
+            aggregator.update(combinedIds.data(), 0, groupCount + 1, combinedRows.size());
+            batchValues[i] = aggregator.finish(combinedRows);
+        }
+        groupCount = combinedRows.size();
+    }
+    else if (groupCount == 0) {
+        emit(batchKeys, batchValues, 0, groups);
+        return;
+    }
+
+    // All groups but the last are complete
+    emit(batchKeys, batchValues, groupCount - 1, groups);
+    openKeys.clear();
+    openValues.clear();
+    for (const auto &column : batchKeys) {
+        openKeys.push_back(detachCell(column, groupCount - 1));
+    }
+    for (const auto &column : batchValues) {
+        openValues.push_back(detachCell(column, groupCount - 1));
+    }
+    isOpen = true;
+}
+
+// Sets groups to the group still open, if any, which ends with the input
+void SortedGroupBy::finish(Dataframe &groups) {
+    if (!isOpen) {
+        groups.headers = keyNames;
+        for (const Aggregation &aggregation : aggregations) {
+            groups.headers.push_back(aggregation.name);
+        }
+        groups.columns.assign(groups.headers.size(), Column());
+        groups.rowCount = 0;
+        return;
+    }
+    emit(openKeys, openValues, 1, groups);
+    openKeys.clear();
+    openValues.clear();
+    isOpen = false;
+}
@@ -0,0 +1,37 @@
+#ifndef SORTEDGROUPBY_HPP
+#define SORTEDGROUPBY_HPP
+
+#include <string>
+#include <vector>
+#include "dataframe.hpp"
+
+// Group-by over a stream of batches sorted on the keys, such as the batches of
+// a CSVBatchReader over a file sorted by them. Groups end where the key
+// changes, so each batch gives the groups it completes and only the group
+// still open at its end is kept, as one row of partial aggregates. Memory
+// stays bounded by the batch size whatever the length of the input.
+//
+//     SortedGroupBy grouping({"Customer"}, {{"Amount", "sum"}});
+//     while (reader.next(batch)) {
+//         grouping.add(batch, groups);
+//         ...
+//     }
+//     grouping.finish(groups);
+class SortedGroupBy {
+private:
+    std::vector<std::string> keyNames;
+    std::vector<Aggregation> aggregations;
+    std::vector<AggregateOp> ops;
+    int direction;
+    bool isOpen;
+    std::vector<Column> openKeys;
+    std::vector<Column> openValues;
+    void emit(std::vector<Column> &keys, std::vector<Column> &values, size_t count, Dataframe &groups) const;
+
+public:
+    SortedGroupBy(const std::vector<std::string> &keys, const std::vector<Aggregation> &aggregations);
+    void add(Dataframe &batch, Dataframe &groups);
+    void finish(Dataframe &groups);
+};
+
+#endif  // SORTEDGROUPBY_HPP
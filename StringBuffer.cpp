@@ -0,0 +1,33 @@
+#include "StringBuffer.hpp"
+#include <cstring>
+
+static const size_t defaultBlockSize = 64 * 1024;
+
+StringBuffer::StringBuffer()
+: current(nullptr), used(0) {
+    //
+}
+
+std::string_view StringBuffer::store(std::string_view val) {
+    if (val.empty()) {
+        return std::string_view();
+    }
+    // Large values get a block of their own and leave the current block open
+    // for the next small values
+    if (val.size() > defaultBlockSize / 4) {
+        std::unique_ptr<char[]> block(new char[val.size()]);
+        std::memcpy(block.get(), val.data(), val.size());
+        std::string_view stored(block.get(), val.size());
+        blocks.push_back(std::move(block));
+        return stored;
+    }
+    if (current == nullptr || defaultBlockSize - used < val.size()) {
+        blocks.emplace_back(new char[defaultBlockSize]);
+        current = blocks.back().get();
+        used = 0;
+    }
+    char *dest = current + used;
+    std::memcpy(dest, val.data(), val.size());
+    used += val.size();
+    return std::string_view(dest, val.size());
+}
@@ -0,0 +1,22 @@
+#ifndef STRINGBUFFER_HPP
+#define STRINGBUFFER_HPP
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+
+// Append-only storage for the bytes of string cells. Stored bytes never move,
+// so the views returned by store() stay valid for the lifetime of the buffer.
+class StringBuffer {
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char *current;
+    size_t used;
+
+public:
+    StringBuffer();
+    std::string_view store(std::string_view val);
+};
+
+#endif  // STRINGBUFFER_HPP
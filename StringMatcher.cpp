@@ -0,0 +1,75 @@
+#include "StringMatcher.hpp"
+#include <algorithm>
+
+StringMatcher::StringMatcher(const std::vector<std::string> &patterns)
+: classCount(1) {
+    // Bytes found in no pattern share class 0, which always leads back to the
+    // root; with all 256 bytes in the patterns there are 257 classes
+    std::fill(byteClass, byteClass + 256, 0);
+    for (const auto &pattern : patterns) {
+        for (unsigned char c : pattern) {
+            if (byteClass[c] == 0) {
+                byteClass[c] = static_cast<uint16_t>(classCount++);
+            }
+        }
+    }
+    // Trie of the patterns, -1 marking a missing edge
+    transitions.assign(classCount, -1);
+    accepting.assign(1, 0);
+    for (const auto &pattern : patterns) {
+        size_t state = 0;
+        for (unsigned char c : pattern) {
+            int32_t &next = transitions[state * classCount + byteClass[c]];
+            if (next < 0) {
+                next = static_cast<int32_t>(accepting.size());
+                accepting.push_back(0);
+                transitions.resize(transitions.size() + classCount, -1);
+            }
+            state = static_cast<size_t>(transitions[state * classCount + byteClass[c]]);
+        }
+        accepting[state] = 1;
+    }
+    // Breadth first, each missing edge takes the edge of the failure state,
+    // which is shallower and so already complete
+    std::vector<int32_t> failure(accepting.size(), 0);
+    std::vector<int32_t> queue;
+    for (size_t c = 0; c < classCount; ++c) {
+        int32_t &next = transitions[c];
+        if (next < 0) {
+            next = 0;
+        }
+        else {
+            queue.push_back(next);
+        }
+    }
+    for (size_t head = 0; head < queue.size(); ++head) {
+        size_t state = static_cast<size_t>(queue[head]);
+        size_t fail = static_cast<size_t>(failure[state]);
+        accepting[state] |= accepting[fail];
+        for (size_t c = 0; c < classCount; ++c) {
+            int32_t &next = transitions[state * classCount + c];
+            int32_t fallback = transitions[fail * classCount + c];
+            if (next < 0) {
+                next = fallback;
+            }
+            else {
+                failure[next] = fallback;
+                queue.push_back(next);
+            }
+        }
+    }
+}
+
+bool StringMatcher::containsAny(std::string_view text) const {
+    size_t state = 0;
+    if (accepting[state]) {
+        return true;
+    }
+    for (unsigned char c : text) {
+        state = static_cast<size_t>(transitions[state * classCount + byteClass[c]]);
+        if (accepting[state]) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,26 @@
+#ifndef STRINGMATCHER_HPP
+#define STRINGMATCHER_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Finds whether a text contains any of a set of patterns in one pass over the
+// text, with an Aho-Corasick automaton built once from the patterns.
+// Failure links are folded into a full transition table over the bytes that
+// occur in the patterns, so each text byte costs one table lookup whatever the
+// number of patterns. An empty pattern is found in every text.
+class StringMatcher {
+private:
+    uint16_t byteClass[256];
+    size_t classCount;
+    std::vector<int32_t> transitions;
+    std::vector<uint8_t> accepting;
+
+public:
+    explicit StringMatcher(const std::vector<std::string> &patterns);
+    bool containsAny(std::string_view text) const;
+};
+
+#endif  // STRINGMATCHER_HPP
@@ -0,0 +1,83 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "utils.hpp"
+
+// Micro-benchmarks of the conversion paths, each printed as nanoseconds per
+// value next to the standard library call it replaces
+
+static volatile double sink;
+
+template<typename F>
+static double nsPerValue(size_t count, F &&body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / count;
+}
+
+static void report(const std::string &name, double baseline, double current) {
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(1)
+        << std::setw(10) << baseline << " ns" << std::setw(10) << current << " ns"
+        << std::setw(8) << baseline / current << "x" << std::endl;
+}
+
+static void benchNumbers() {
+    const size_t count = 1000000;
+    std::mt19937_64 random(42);
+    std::uniform_real_distribution<double> distribution(-1e6, 1e6);
+    std::vector<double> values(count);
+    std::vector<std::string> doubleText(count);
+    std::vector<std::string> intText(count);
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = distribution(random);
+        doubleText[i] = formatDouble(values[i]);
+        intText[i] = std::to_string(static_cast<int64_t>(values[i]));
+    }
+    std::cout << std::left << std::setw(28) << "conversion" << std::right << std::setw(13) << "std"
+        << std::setw(13) << "utils" << std::setw(9) << "gain" << std::endl;
+
+    report("parse double",
+        nsPerValue(count, [&] { for (const auto &s : doubleText) sink = sink + std::stod(s); }),
+        nsPerValue(count, [&] { double d; for (const auto &s : doubleText) { parseDouble(s, d); sink = sink + d; } }));
+    report("parse int64",
+        nsPerValue(count, [&] { for (const auto &s : intText) sink = sink + std::stoll(s); }),
+        nsPerValue(count, [&] { int64_t i; for (const auto &s : intText) { parseInt64(s, i); sink = sink + i; } }));
+    report("format double (6 digits)",
+        nsPerValue(count, [&] { for (double v : values) sink = sink + std::to_string(v).size(); }),
+        nsPerValue(count, [&] { for (double v : values) sink = sink + formatDouble(v, 6).size(); }));
+    report("format double (2 digits)",
+        nsPerValue(count, [&] {
+            for (double v : values) {
+                std::ostringstream out;
+                out << std::fixed << std::setprecision(2) << v;
+                sink = sink + out.str().size();
+            }
+        }),
+        nsPerValue(count, [&] { for (double v : values) sink = sink + formatDouble(v, 2).size(); }));
+    report("format double (shortest)",
+        nsPerValue(count, [&] {
+            char buffer[32];
+            for (double v : values) {
+                for (int digits = 15; digits <= 17; ++digits) {
+                    std::snprintf(buffer, sizeof(buffer), "%.*g", digits, v);
+                    if (std::strtod(buffer, nullptr) == v) {
+                        break;
+                    }
+                }
+                sink = sink + buffer[0];
+            }
+        }),
+        nsPerValue(count, [&] { for (double v : values) sink = sink + formatDouble(v).size(); }));
+}
+
+int main() {
+    benchNumbers();
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "dataframe.hpp"
+#include "ReduceKernels.hpp"
 
 template void Dataframe::filterRows<std::string>(const std::string &colName, const std::string &op, std::string value);
 template void Dataframe::filterRows<double>(const std::string &colName, const std::string &op, double value);
@@ -6,47 +7,56 @@ template void Dataframe::dropColumns<std::string, std::string>(std::string &&sta
 template void Dataframe::dropColumns<const char *, const char *>(const char* &&start, const char* &&end);
 
 Dataframe::Dataframe() {
-    isReplacingNulls = true;
+    rowCount = 0;
+    isReplacingNulls = false;
     nullReplacement = "0";
 }
 
-Dataframe::Dataframe(const std::string path, char sep, int rowSkip) {
-    doc = rapidcsv::Document(
-        path,
-        rapidcsv::LabelParams(rowSkip, -1),
-        rapidcsv::SeparatorParams(sep)
-    );
-    headers = doc.GetColumnNames();
-    readData();
+Dataframe::Dataframe(const std::string path, char sep, int rowSkip, const std::vector<std::string> &categoricalColumns) {
+    CSVOptions options;
+    options.sep = sep;
+    options.rowSkip = rowSkip;
+    options.categoricalColumns = categoricalColumns;
+    rowCount = 0;
+    isReplacingNulls = false;
+    nullReplacement = "0";
+    readData(path, options);
 }
 
-Dataframe::Dataframe(const Dataframe &other) {
-    headers.resize(other.headers.size());
-    for (size_t i = 0; i < other.headers.size(); ++i) {
-        headers[i] = other.headers[i];
-    }
+Dataframe::Dataframe(const std::string path, const CSVOptions &options) {
+    rowCount = 0;
+    isReplacingNulls = options.replaceNulls;
+    nullReplacement = options.nullReplacement;
+    readData(path, options);
+}
+
+Dataframe::Dataframe(const Dataframe &other)
+: headers(other.headers), columns(other.columns), rowCount(other.rowCount) {
     this->isReplacingNulls = other.isReplacingNulls;
     this->nullReplacement = other.nullReplacement;
-    for (size_t i = 0; i < other.rows.size(); ++i) {
-        CSVRow row(i, isReplacingNulls, nullReplacement);
-        row.deepCopyData(other.rows[i]);
-        rows.push_back(row);
-    }
 }
 
-Dataframe::Dataframe(std::vector<std::vector<std::string>> &dfData) {
-    headers.resize(dfData[0].size());
-    for (size_t i = 0; i < dfData[0].size(); ++i) {
-        headers[i] = dfData[0][i];
+Dataframe::Dataframe(std::vector<std::vector<std::string>> &dfData, bool replaceNulls,
+    const std::string &nullReplacement) {
+    headers = dfData[0];
+    this->isReplacingNulls = replaceNulls;
+    this->nullReplacement = nullReplacement;
+    rowCount = dfData.size() - 1;
+    columns.assign(headers.size(), Column());
+    for (auto &column : columns) {
+        column.reserve(rowCount);
     }
-    this->isReplacingNulls = true;
-    this->nullReplacement = "0";
     for (size_t i = 1; i < dfData.size(); ++i) {
-        CSVRow row(i, isReplacingNulls, nullReplacement);
-        for (size_t j = 0; j < dfData[i].size(); ++j) {
-            row.addItem(headers[j], dfData[i][j]);
+        for (size_t j = 0; j < headers.size(); ++j) {
+            std::string val = j < dfData[i].size() ? dfData[i][j] : "";
+            columns[j].push_back(val == "NaN" ? "" : val);
+        }
+    }
+    for (auto &column : columns) {
+        column.inferType();
+        if (isReplacingNulls) {
+            column.fillNull(nullReplacement);
         }
-        rows.push_back(row);
     }
 }
 
@@ -58,18 +68,45 @@ int Dataframe::getColumnIndex(std::string colName) {
     return -1;
 }
 
-void Dataframe::renameColumns(const std::vector<std::pair<std::string, std::string>> &columns, bool renameCSVRowMaps) {
+Column &Dataframe::getColumnData(const std::string &colName) {
+    int index = getColumnIndex(colName);
+    if (index < 0) {
+        throw std::out_of_range("column not found: " + colName);
+    }
+    return columns[index];
+}
+
+size_t Dataframe::getRowCount() const {
+    return rowCount;
+}
+
+void Dataframe::addColumn(const std::string &colName, Column &&column) {
+    column.resize(rowCount);
+    int index = getColumnIndex(colName);
+    if (index >= 0) {
+        columns[index] = std::move(column);
+    }
+    else {
+        headers.push_back(colName);
+        columns.push_back(std::move(column));
+    }
+}
+
+// Keeps only the rows at the given positions, in the given order
+void Dataframe::selectRows(const std::vector<size_t> &indices) {
+    for (auto &column : columns) {
+        column.select(indices);
+    }
+    rowCount = indices.size();
+}
+
+void Dataframe::renameColumns(const std::vector<std::pair<std::string, std::string>> &columns) {
     for (const auto &p : columns) {
         std::string currName = p.first;
         std::string newName = p.second;
         int index = getColumnIndex(currName);
         if (index >= 0) {
             headers[index] = newName;
-            if (renameCSVRowMaps) {
-                for (auto &row : rows) {
-                    row.renameCol(currName, newName);
-                }
-            }
         }
         else {
             std::cout << "Column not found: " << currName << std::endl;
@@ -77,14 +114,26 @@ void Dataframe::renameColumns(const std::vector<std::pair<std::string, std::stri
     }
 }
 
-void Dataframe::readData() {
-    for (size_t i = 0; i < doc.GetRowCount(); ++i) {
-        CSVRow rowData(i, isReplacingNulls, nullReplacement);
-        for (size_t j = 0; j < headers.size(); ++j) {
-            rowData.addItem(headers[j], doc.GetCell<std::string>(j, i));
+// Row count below which type inference stays on the calling thread
+static const size_t MIN_PARALLEL_ROWS = 1 << 16;
+
+void Dataframe::readData(const std::string &path, const CSVOptions &options) {
+    CSVReader reader(path, options);
+    reader.read(headers, columns);
+    rowCount = columns.empty() ? 0 : columns[0].size();
+    // Columns are independent, so their types are inferred in parallel once
+    // there are enough rows to pay for starting the threads
+    unsigned threads = rowCount < MIN_PARALLEL_ROWS ? 1 : threadCount(options.threads);
+    parallelFor(columns.size(), threads, [&](size_t col) {
+        columns[col].inferType();
+        if (options.replaceNulls) {
+            columns[col].fillNull(options.nullReplacement);
         }
-        rows.push_back(rowData);
-    }
+    });
+}
+
+void Dataframe::setColumnType(const std::string &colName, ColumnType type) {
+    getColumnData(colName).convertTo(type);
 }
 
 
@@ -101,24 +150,32 @@ void Dataframe::printHeaders(const std::vector<std::string> &headers) {
 
 void Dataframe::printDataframe() {
     printHeaders(headers);
-    for (auto &row : rows){
-        row.printRow(headers);
+    for (size_t i = 0; i < rowCount; ++i) {
+        for (const auto &column : columns) {
+            std::cout << column.get(i) << "\t";
+        }
+        std::cout << std::endl;
     }
 }
 
 void Dataframe::replaceNull(std::string replace, const std::vector<std::string> &colNames) {
-    if (!colNames.empty()) {
-        for (auto &row : rows) {
-            row.removeNull(colNames, replace);
-        }
-    }
-    else {
-        for (auto &row : rows) {
-            row.removeNull(headers, replace);
+    const std::vector<std::string> &targets = colNames.empty() ? headers : colNames;
+    for (const auto &col : targets) {
+        int index = getColumnIndex(col);
+        if (index >= 0) {
+            columns[index].fillNull(replace);
         }
     }
 }
 
+bool Dataframe::isNull(const std::string &colName, int row) {
+    return getColumnData(colName).isNull(row);
+}
+
+size_t Dataframe::nullCount(const std::string &colName) {
+    return getColumnData(colName).nullCount();
+}
+
 void Dataframe::setReplaceNull(bool rep) {
     isReplacingNulls = rep;
 }
@@ -141,15 +198,16 @@ void Dataframe::setNullReplacement(std::string rep) {
 } */ // FIXME
 
 void Dataframe::dropColumns(const std::vector<std::string> &columns) {
-    for (auto &row : rows) {
-        row.dropCols(columns);
+    std::vector<std::string> keptHeaders;
+    std::vector<Column> keptColumns;
+    for (size_t i = 0; i < headers.size(); ++i) {
+        if (std::find(columns.begin(), columns.end(), headers[i]) == columns.end()) {
+            keptHeaders.push_back(headers[i]);
+            keptColumns.push_back(std::move(this->columns[i]));
+        }
     }
-    auto it = headers.begin();
-    headers.erase(
-        std::remove_if(headers.begin(), headers.end(), [&](const std::string &col) {
-            return std::find(columns.begin(), columns.end(), col) != columns.end();
-        }), headers.end()
-    );
+    headers.swap(keptHeaders);
+    this->columns.swap(keptColumns);
 }
 
 // Start and end inclusive
@@ -182,8 +240,9 @@ void Dataframe::dropColumns(T1 &&start, T2 &&end) {
 
 void Dataframe::removeSpecialCharacters(const std::vector<std::string> &specialCharacters, const std::string &col) {
     std::string replace = "";
-    for (auto &row : rows) {
-        std::string input = row.getData(col);
+    Column &column = getColumnData(col);
+    for (size_t i = 0; i < rowCount; ++i) {
+        std::string input = column.get(i);
         for (const std::string &c : specialCharacters) {
             size_t pos = 0;
             while ((pos = input.find(c, pos)) != std::string::npos) {
@@ -191,7 +250,7 @@ void Dataframe::removeSpecialCharacters(const std::vector<std::string> &specialC
                 pos += replace.length();
             }
         }
-        row.setData(input, col);
+        column.set(i, input);
     }
 }
 
@@ -220,32 +279,63 @@ void Dataframe::createNewColumnMult(const std::string &colName, const std::strin
 }*/
 
 
-void Dataframe::createNewColumn(const std::string &colName, std::string &defaultValue) {
-    headers.push_back(colName);
-    for (auto &row : rows) {
-        row.addItem(colName, defaultValue);
+// Null cells count as zero when adding or subtracting columns
+static double numericOrZero(const Column &column, size_t row) {
+    if (column.isNull(row)) {
+        return 0.;
     }
+    return column.getDouble(row);
+}
+
+void Dataframe::createNewColumn(const std::string &colName, std::string &defaultValue) {
+    std::string val = (defaultValue == "" && isReplacingNulls) ? nullReplacement : defaultValue;
+    Column newColumn(rowCount, val);
+    newColumn.inferType();
+    addColumn(colName, std::move(newColumn));
 }
 
 void Dataframe::createNewColumn(const std::string &colName, std::vector<std::string> &sumColumns) {
-    headers.push_back(colName);
-    for (auto &row : rows) {
-        row.addItem(colName, row.sumNumericalData(sumColumns));
+    std::vector<const Column *> operands;
+    for (const auto &col : sumColumns) {
+        int index = getColumnIndex(col);
+        if (index >= 0) {
+            operands.push_back(&columns[index]);
+        }
     }
+    Column newColumn(ColumnType::Double);
+    newColumn.reserve(rowCount);
+    for (size_t i = 0; i < rowCount; ++i) {
+        double sum = 0;
+        for (const Column *operand : operands) {
+            sum += numericOrZero(*operand, i);
+        }
+        newColumn.pushDouble(sum);
+    }
+    addColumn(colName, std::move(newColumn));
 }
 
 void Dataframe::createNewColumn(const std::string &colName, std::string &col1, std::string &col2) {
-    headers.push_back(colName);
-    for (auto &row : rows) {
-        row.addItem(colName, row.subtractNumericalData(col1, col2));
+    const Column &left = getColumnData(col1);
+    const Column &right = getColumnData(col2);
+    Column newColumn(ColumnType::Double);
+    newColumn.reserve(rowCount);
+    for (size_t i = 0; i < rowCount; ++i) {
+        newColumn.pushDouble(numericOrZero(left, i) - numericOrZero(right, i));
     }
+    addColumn(colName, std::move(newColumn));
 }
 
 void Dataframe::createNewColumn(const std::string &colName, const std::string &baseColumn, const std::string &op, double value) {
     double result;
-    headers.push_back(colName);
-    for (auto &row : rows) {
-        double cellVal = std::stod(row.getData(baseColumn));
+    const Column &base = getColumnData(baseColumn);
+    Column newColumn(ColumnType::Double);
+    newColumn.reserve(rowCount);
+    for (size_t i = 0; i < rowCount; ++i) {
+        if (base.isNull(i)) {
+            newColumn.pushNull();
+            continue;
+        }
+        double cellVal = base.getDouble(i);
         if (op == "/") {
             result = cellVal / value;
         }
@@ -261,83 +351,196 @@ void Dataframe::createNewColumn(const std::string &colName, const std::string &b
         else {
             result = cellVal;
         }
-        row.addItem(colName, std::to_string(result));
+        newColumn.pushDouble(result);
     }
+    addColumn(colName, std::move(newColumn));
+}
+
+// Adds a column computed from a formula over other columns, for example
+// df.createNewColumn("Monthly", Expression("Salary / 12 + Bonus * 0.5"))
+void Dataframe::createNewColumn(const std::string &colName, const Expression &expression) {
+    addColumn(colName, expression.evaluate(headers, columns, rowCount));
 }
 
 int Dataframe::getRowIndex(CSVRow &row) {
-    auto it = std::find(rows.begin(), rows.end(), row);
-    if (it != rows.end()) {
-        return std::distance(rows.begin(), it);
+    if (row.getDataframe() == this) {
+        return row.getRowID() < rowCount ? static_cast<int>(row.getRowID()) : -1;
     }
-    else {
-        return -1;
+    for (size_t i = 0; i < rowCount; ++i) {
+        if (CSVRow(this, i) == row) {
+            return i;
+        }
     }
+    return -1;
 }
 
 void Dataframe::concatCol(Dataframe &df) {
     std::vector<std::string> newHeaders = df.getHeaders();
-    headers.insert(headers.end(), newHeaders.begin(), newHeaders.end());
-    for (auto i = 0; i < df.getRows().size(); ++i) {
-        for (auto &col : newHeaders) {
-            setValue(col, i, df.getValue(col, i));
-        }
+    for (auto &col : newHeaders) {
+        Column column = df.getColumnData(col);
+        addColumn(col, std::move(column));
     }
 }
 
 void Dataframe::concatRow(Dataframe &df) {
-    std::vector<std::string> newHeaders = df.getHeaders();
-    for (auto &row : df.getRows()) {
-        CSVRow newRow;
-        newRow.deepCopyData(row);
-        rows.push_back(newRow);
+    size_t otherCount = df.getRowCount();
+    for (size_t j = 0; j < headers.size(); ++j) {
+        int index = df.getColumnIndex(headers[j]);
+        if (index >= 0) {
+            columns[j].append(df.columns[index]);
+        }
+        else {
+            columns[j].resize(rowCount + otherCount);
+        }
+    }
+    rowCount += otherCount;
+}
+
+// The validity bitmap of a column for the reduce kernels, nullptr without nulls
+static const uint64_t *validityWords(const Column &column) {
+    return column.nullCount() > 0 ? column.validityData().data() : nullptr;
+}
+
+// The values of a column as doubles, read in place from Double columns and
+// converted otherwise; nulls are left as 0 and text that is not a number throws
+static const double *doubleValues(const Column &column, size_t rowCount, std::vector<double> &converted) {
+    if (column.getType() == ColumnType::Double) {
+        return column.doubleData().data();
+    }
+    converted.assign(rowCount, 0.);
+    if (column.getType() == ColumnType::Int64) {
+        const std::vector<int64_t> &ints = column.intData();
+        std::copy(ints.begin(), ints.begin() + rowCount, converted.begin());
+        return converted.data();
+    }
+    for (size_t i = 0; i < rowCount; ++i) {
+        if (!column.isNull(i)) {
+            converted[i] = column.getDouble(i);
+        }
     }
+    return converted.data();
 }
 
-std::string Dataframe::max(const std::string &col) {
-    double maxVal = -999999.;
-    for (auto &row : rows) {
-        double cellVal = std::stod(row.getData(col));
-        if (cellVal > maxVal) {
-            maxVal = cellVal;
+// Integer columns are summed exactly, in doubles only when the total overflows
+double Dataframe::sum(const std::string &col, bool compensated) {
+    const Column &column = getColumnData(col);
+    if (column.getType() == ColumnType::Int64) {
+        int64_t total;
+        if (sumInts(column.intData().data(), rowCount, validityWords(column), total)) {
+            return static_cast<double>(total);
         }
     }
-    return std::to_string(maxVal);
-} 
+    std::vector<double> converted;
+    return sumDoubles(doubleValues(column, rowCount, converted), rowCount, validityWords(column), compensated);
+}
+
+// NaN when the column has no values
+double Dataframe::min(const std::string &col) {
+    const Column &column = getColumnData(col);
+    if (column.getType() == ColumnType::Int64) {
+        int64_t low, high;
+        if (!minMaxInts(column.intData().data(), rowCount, validityWords(column), low, high)) {
+            return std::nan("");
+        }
+        return static_cast<double>(low);
+    }
+    std::vector<double> converted;
+    double low, high;
+    if (!minMaxDoubles(doubleValues(column, rowCount, converted), rowCount, validityWords(column), low, high)) {
+        return std::nan("");
+    }
+    return low;
+}
 
-std::string Dataframe::sum(const std::string &col) {
-    double sum = 0;
-    for (auto &row : rows) {
-        double cellVal = std::stod(row.getData(col));
-        sum += cellVal;
+double Dataframe::max(const std::string &col) {
+    const Column &column = getColumnData(col);
+    if (column.getType() == ColumnType::Int64) {
+        int64_t low, high;
+        if (!minMaxInts(column.intData().data(), rowCount, validityWords(column), low, high)) {
+            return std::nan("");
+        }
+        return static_cast<double>(high);
+    }
+    std::vector<double> converted;
+    double low, high;
+    if (!minMaxDoubles(doubleValues(column, rowCount, converted), rowCount, validityWords(column), low, high)) {
+        return std::nan("");
     }
-    return std::to_string(sum);
-} 
+    return high;
+}
+
+size_t Dataframe::count(const std::string &col) {
+    return validCount(rowCount, validityWords(getColumnData(col)));
+}
+
+double Dataframe::mean(const std::string &col, bool compensated) {
+    size_t valid = count(col);
+    return valid == 0 ? std::nan("") : sum(col, compensated) / valid;
+}
+
+// Sample variance, with the deviations from the mean summed in a second pass
+// rather than from the sum of squares, which cancels badly for large values
+double Dataframe::var(const std::string &col) {
+    const Column &column = getColumnData(col);
+    const uint64_t *validity = validityWords(column);
+    size_t valid = validCount(rowCount, validity);
+    if (valid < 2) {
+        return std::nan("");
+    }
+    std::vector<double> converted;
+    const double *values = doubleValues(column, rowCount, converted);
+    double mean = sumDoubles(values, rowCount, validity, true) / valid;
+    return squaredDeviations(values, rowCount, validity, mean) / (valid - 1);
+}
 
 std::vector<std::string> Dataframe::unique(const std::string &col) {
     std::unordered_set<std::string> uniqueValues;
     std::vector<std::string> result;
-    for (auto &row : rows) {
-        uniqueValues.insert(row.getData(col));
+    const Column &column = getColumnData(col);
+    if (column.getType() == ColumnType::Categorical) {
+        const std::vector<std::string_view> &dictionary = column.dictionaryData();
+        std::vector<bool> used(dictionary.size(), false);
+        for (int32_t code : column.codeData()) {
+            if (code >= 0) {
+                used[code] = true;
+            }
+        }
+        if (column.nullCount() > 0) {
+            result.push_back("");
+        }
+        for (size_t code = 0; code < dictionary.size(); ++code) {
+            if (used[code]) {
+                result.push_back(std::string(dictionary[code]));
+            }
+        }
+        return result;
+    }
+    for (size_t i = 0; i < rowCount; ++i) {
+        uniqueValues.insert(column.get(i));
     }
     std::copy(uniqueValues.begin(), uniqueValues.end(), std::back_inserter(result));
     return result;
 }
 
 void Dataframe::roundDouble(const std::string &col, int precision) {
-    for (auto &row : rows) {
-        double cellVal = std::stod(row.getData(col));
-        double multiplier = std::pow(10, precision);
+    Column &column = getColumnData(col);
+    column.convertTo(ColumnType::Double);
+    double multiplier = std::pow(10, precision);
+    for (size_t i = 0; i < rowCount; ++i) {
+        if (column.isNull(i)) {
+            continue;
+        }
+        double cellVal = column.getDouble(i);
         double rounded = std::round(cellVal * multiplier) / multiplier;
-        std::stringstream ss;
-        ss << std::fixed << std::setprecision(precision) << rounded;
-        row.setData(ss.str(), col);
+        column.setDouble(i, rounded);
     }
+    column.setPrecision(precision);
 }
 
 void Dataframe::sliceValues(const std::string &col, int start, int end) {
-    for (auto &row : rows) {
-        std::string data = row.getData(col);
+    Column &column = getColumnData(col);
+    for (size_t i = 0; i < rowCount; ++i) {
+        std::string data = column.get(i);
         if (start < 0) {
             start = 0;
         }
@@ -345,177 +548,239 @@ void Dataframe::sliceValues(const std::string &col, int start, int end) {
             end = data.size();
         }
         std::string slicedData = data.substr(start, end - start);
-        row.setData(slicedData, col);
+        column.set(i, slicedData);
     }
 }
 
 bool Dataframe::operationResult(CSVRow &row, const std::string &col, const std::string &op, std::string &value) {
-    std::string data = row.getData(col);
-    if (op == "==") {
-        return data == value;
-    }
-    else if (op == "!=") {
-        std::vector<std::string> splitValues = splitStr(value, ',');
-        for (auto &st : splitValues) {
-            if (data == value) {
-                return false;
-            }
-        }
-        return true;
-    }
-    else if (op == "in") {
-        size_t pos = data.find(value);
-        return pos != std::string::npos;
-    }
-    else if (op == "or") {
-        std::vector<std::string> splitValues = splitStr(value, ',');
-        for (auto &st : splitValues) {
-            size_t pos = data.find(st);
-            if (pos != std::string::npos) {
-                return true;
-            }
-        }
-        return false;
-    }
-    else if (op == "~") {
-        size_t pos = data.find(value);
-        return pos == std::string::npos;
-    }
-    else if (op == "startswith") {
-        if (value.size() <= data.size()) {
-            std::string substrData = data.substr(0, value.size());
-            return substrData == value;
-        }
-        return false;
-    }
-    return true;
+    return Predicate(col, op, value).matchesText(row.getData(col));
 }
 
-
 bool Dataframe::operationResult(CSVRow &row, const std::string &col, const std::string &op, double value) {
-    std::string data = row.getData(col);
+    const Column &column = getColumnData(col);
     if (op == "len"){
         int length = static_cast<int>(value);
-        return data.size() == length;
+        return column.get(row.getRowID()).size() == length;
     }
-    double doubleData = std::stod(data);
-    if (op == "==") {
-        return doubleData == value;
-    }
-    else if (op == "!=") {
-        return doubleData != value;
+    if (column.isNull(row.getRowID())) {
+        return false;
     }
-    else if (op == "<") {
-        return doubleData < value;
+    return Predicate(col, op, value).matchesNumber(column.getDouble(row.getRowID()));
+}
+
+// Sets one bit per row passing the predicate, cells of a missing column read
+// as empty
+void Dataframe::evaluateFilter(const Predicate &predicate, std::vector<uint64_t> &mask) {
+    if (getColumnIndex(predicate.column) < 0 && !predicate.isNumeric) {
+        mask.assign((rowCount + 63) / 64, predicate.matchesText("") ? ~0ULL : 0);
+        return;
     }
-    else if (op == "<=") {
-        return doubleData <= value;
+    predicate.evaluate(getColumnData(predicate.column), rowCount, mask);
+}
+
+// Keeps the rows whose bit is set, compacting every column in place
+void Dataframe::compactRows(const std::vector<uint64_t> &mask) {
+    size_t kept = 0;
+    for (size_t w = 0; w < mask.size(); ++w) {
+        uint64_t word = mask[w];
+        if (w == mask.size() - 1 && rowCount % 64 != 0) {
+            word &= (1ULL << (rowCount % 64)) - 1;
+        }
+        kept += popCount(word);
     }
-    else if (op == ">") {
-        return doubleData > value;
+    if (kept == rowCount) {
+        return;
     }
-    else if (op == ">=") {
-        return doubleData >= value;
+    for (auto &column : columns) {
+        column.compact(mask);
     }
-    return true;
+    rowCount = kept;
 }
 
+// The predicate is compiled once and run over the column storage into a
+// bitmask, then the columns are compacted in a second pass
 template<typename T> 
 void Dataframe::filterRows(const std::string &colName, const std::string &op, T value) {
-    auto it = rows.begin();
-    while (it != rows.end()) {
-        if (!operationResult(*it, colName, op, value)) {
-            it = rows.erase(it);
-        }
-        else {
-            ++it;
-        }
-    }
+    std::vector<uint64_t> mask;
+    evaluateFilter(Predicate(colName, op, value), mask);
+    compactRows(mask);
 }
+
+// Keeps the rows passing every condition of the expression, all evaluated
+// in one scan before a single compaction
+void Dataframe::filter(const FilterExpression &expression) {
+    std::vector<uint64_t> mask;
+    expression.evaluate(headers, columns, rowCount, mask);
+    compactRows(mask);
+}
+
 std::vector<CSVRow> Dataframe::getRows() {
+    std::vector<CSVRow> rows;
+    rows.reserve(rowCount);
+    for (size_t i = 0; i < rowCount; ++i) {
+        rows.emplace_back(this, i);
+    }
     return rows;
 }
 
+// Renames the columns by position
 void Dataframe::renameHeader(const std::vector<std::string> &columns) {
-    headers.clear();
-    for (const auto &col : columns) {
-        headers.push_back(col);
+    if (columns.size() != headers.size()) {
+        std::cerr << "Error: Expected " << headers.size() << " column names, got " << columns.size() << "." << std::endl;
+        return;
     }
+    headers = columns;
 }
 
 std::string Dataframe::sumDigitStr(std::string str1, std::string str2) {
-    try {
-        double value1 = std::stod(str1);
-        double value2 = std::stod(str2);
-        return std::to_string(value1 + value2);
-    } catch (const std::invalid_argument& ex) {
+    double value1;
+    double value2;
+    if (!parseDouble(str1, value1) || !parseDouble(str2, value2)) {
         return str1;
     }
+    return formatDouble(value1 + value2, 6);
 }
 
 void Dataframe::createEqMatchColumn(const std::string &colName, const std::string &eq) {
-    headers.push_back(colName);
-    for (auto i = 0; i < rows.size(); ++i) {
-        int matches = rows[i].matchCount(eq);
-        setValue(colName, i, std::to_string(matches));
+    Column newColumn(ColumnType::Int64);
+    newColumn.reserve(rowCount);
+    for (size_t i = 0; i < rowCount; ++i) {
+        int matches = CSVRow(this, i).matchCount(eq);
+        newColumn.pushInt(matches);
     }
+    addColumn(colName, std::move(newColumn));
 }
 
 void Dataframe::sortBy(const std::string &colName, bool ascending) {
-    auto compareRows = [colName, ascending](CSVRow& row1, CSVRow& row2) {
-        double v1 = std::stod(row1.getData(colName));
-        double v2 = std::stod(row2.getData(colName));
+    const Column &column = getColumnData(colName);
+    std::vector<double> keys(rowCount);
+    for (size_t i = 0; i < rowCount; ++i) {
+        keys[i] = column.getDouble(i);
+    }
+    std::vector<size_t> order(rowCount);
+    for (size_t i = 0; i < rowCount; ++i) {
+        order[i] = i;
+    }
+    // Nulls go last in both directions
+    auto compareRows = [&column, &keys, ascending](size_t row1, size_t row2) {
+        bool null1 = column.isNull(row1);
+        bool null2 = column.isNull(row2);
+        if (null1 || null2) {
+            return !null1 && null2;
+        }
         if (ascending) {
-            return v1 < v2;
+            return keys[row1] < keys[row2];
         }
         else {
-            return v1 >= v2;
+            return keys[row1] > keys[row2];
         }
     };
-    std::sort(rows.begin(), rows.end(), compareRows);
+    std::stable_sort(order.begin(), order.end(), compareRows);
+    selectRows(order);
 }
 
+// Categorical cells contribute their fixed-width code to a row key
+static void appendKeyPart(std::string &key, const Column &column, size_t row, bool byCode = true) {
+    if (byCode && column.getType() == ColumnType::Categorical) {
+        int32_t code = column.codeData()[row];
+        key.append(reinterpret_cast<const char *>(&code), sizeof(code));
+    }
+    else {
+        key += column.get(row);
+    }
+    key += '\x1f';
+}
+
+// Keeps the first row of each group of equal keys, numeric columns holding
+// the sums of the group and text columns their first value
 void Dataframe::groupBy(const std::vector<std::string> &colNames) {
-    std::map<std::string, std::vector<CSVRow>> groups;    
-    std::vector<std::string> remainingHeaders;
-    std::vector<int> toRemove;
-    std::copy_if(
-        headers.begin(), headers.end(), std::back_inserter(remainingHeaders),
-        [&](const std::string &col) {
-            return std::find(colNames.begin(), colNames.end(), col) == colNames.end();
-        }
-    );
-
-    for (CSVRow &row : rows) {
-        std::string key;
-        for (const std::string &col : colNames) {
-            key += row.getData(col);
-        }
-        groups[key].push_back(row);
-    }
-    if (!groups.empty()) {
-        for (auto groupIt = groups.begin(); groupIt != groups.end(); ++groupIt) {
-            std::vector<CSVRow> &currentGroupRows = groupIt->second;
-            const int baseRowIdx = getRowIndex(currentGroupRows.front());
-            for (auto rowIt = std::next(currentGroupRows.begin()); rowIt != currentGroupRows.end(); ++rowIt) {
-                CSVRow currentRow = *rowIt;
-                for (const auto &col : remainingHeaders) {
-                    std::string newVal = sumDigitStr(rows[baseRowIdx].getData(col), currentRow.getData(col));
-                    rows[baseRowIdx].setData(newVal, col);
-                }
-                toRemove.push_back(getRowIndex(currentRow));
+    std::vector<const Column *> keys;
+    std::vector<int> remainingIndices;
+    for (const std::string &col : colNames) {
+        int idx = getColumnIndex(col);
+        if (idx >= 0) {
+            keys.push_back(&columns[idx]);
+        }
+    }
+    for (size_t j = 0; j < headers.size(); ++j) {
+        if (std::find(colNames.begin(), colNames.end(), headers[j]) == colNames.end()) {
+            remainingIndices.push_back(j);
+        }
+    }
+    GroupTable groups(keys);
+    std::vector<uint32_t> groupIds(rowCount);
+    groups.insert(0, rowCount, groupIds.data());
+    const std::vector<size_t> &kept = groups.firstRows();
+
+    for (int idx : remainingIndices) {
+        Column &column = columns[idx];
+        if (column.isNumeric()) {
+            Aggregator sum(column, AggregateOp::Sum);
+            sum.update(groupIds.data(), 0, rowCount, groups.size());
+            column = sum.finish(kept);
+            continue;
+        }
+        if (column.getType() != ColumnType::String) {
+            Aggregator first(column, AggregateOp::First);
+            first.update(groupIds.data(), 0, rowCount, groups.size());
+            column = first.finish(kept);
+            continue;
+        }
+        for (size_t i = 0; i < rowCount; ++i) {
+            const size_t baseRowIdx = kept[groupIds[i]];
+            if (i == baseRowIdx || column.isNull(i)) {
+                continue;
+            }
+            if (column.isNull(baseRowIdx)) {
+                column.set(baseRowIdx, column.get(i));
+            }
+            else {
+                column.set(baseRowIdx, sumDigitStr(column.get(baseRowIdx), column.get(i)));
             }
         }
+        column.select(kept);
     }
-    std::unordered_set<int> indicesToRemove(toRemove.begin(), toRemove.end());
-    std::vector<CSVRow> newRows;
-    newRows.reserve(rows.size() - toRemove.size());
-    for (int i = 0; i < rows.size(); ++i) {
-        if (indicesToRemove.find(i) == indicesToRemove.end()) {
-            newRows.push_back(rows[i]);
+    for (size_t j = 0; j < columns.size(); ++j) {
+        if (std::find(remainingIndices.begin(), remainingIndices.end(), static_cast<int>(j)) == remainingIndices.end()) {
+            columns[j].select(kept);
         }
     }
-    rows = newRows;
+    rowCount = kept.size();
+}
+
+// Replaces the dataframe with one row per group of equal keys, in order of
+// first appearance: the key columns then a column per aggregation. threads
+// workers share the grouping, 0 meaning one per hardware thread.
+// Throws std::out_of_range for a missing column.
+void Dataframe::groupBy(const std::vector<std::string> &colNames, const std::vector<Aggregation> &aggregations,
+    unsigned threads) {
+    std::vector<const Column *> keys;
+    for (const std::string &col : colNames) {
+        keys.push_back(&getColumnData(col));
+    }
+    std::vector<const Column *> values;
+    std::vector<AggregateOp> ops;
+    for (const Aggregation &aggregation : aggregations) {
+        values.push_back(&getColumnData(aggregation.column));
+        ops.push_back(aggregation.op);
+    }
+    std::vector<size_t> firstRows;
+    std::vector<Column> results;
+    aggregateGroups(keys, values, ops, rowCount, threads, firstRows, results);
+
+    std::vector<std::string> groupHeaders;
+    std::vector<Column> groupColumns;
+    for (size_t k = 0; k < keys.size(); ++k) {
+        groupHeaders.push_back(colNames[k]);
+        groupColumns.push_back(keys[k]->copyRows(firstRows));
+    }
+    for (size_t a = 0; a < aggregations.size(); ++a) {
+        groupHeaders.push_back(aggregations[a].name);
+        groupColumns.push_back(std::move(results[a]));
+    }
+    headers = std::move(groupHeaders);
+    columns = std::move(groupColumns);
+    rowCount = firstRows.size();
 }
 
 void Dataframe::loc(std::vector<std::string> &colNames) {
@@ -539,13 +804,13 @@ std::unordered_map<std::string, std::string> Dataframe::prepareMerge(const std::
             if (std::find(headers.begin(), headers.end(), col) == headers.end()) {
                 // createNewColumn(col, defaultValue);
                 rightMap[col] = col;
-                headers.push_back(col);
+                addColumn(col, Column());
             }
             else {
                 std::string newNameLeft = col + suffixLeft;
                 std::string newNameRight = col + suffixRight;
                 renameColumns({{col, newNameLeft}});
-                headers.push_back(newNameRight);
+                addColumn(newNameRight, Column());
                 // createNewColumn(newNameRight, defaultValue);
                 rightMap[col] = newNameRight;
             }
@@ -555,51 +820,98 @@ std::unordered_map<std::string, std::string> Dataframe::prepareMerge(const std::
 }
 
 void Dataframe::setValue(const std::string &colName, int row, const std::string &value) {
-    rows[row].setData(value, colName);
+    int index = getColumnIndex(colName);
+    if (index < 0) {
+        std::cout << "Column not found: " << colName << std::endl;
+        return;
+    }
+    columns[index].set(row, value);
 }
 
 std::string Dataframe::getValue(const std::string &colName, int row) {
-    return rows[row].getData(colName);
+    int index = getColumnIndex(colName);
+    if (index < 0) {
+        return "";
+    }
+    return columns[index].get(row);
 }
 
 void Dataframe::setColumnValue(const std::string &colName, const std::string &value) {
-    for (auto i = 0; i < rows.size(); ++i) {
-        setValue(colName, i, value);
-    }
+    Column &column = getColumnData(colName);
+    column = Column(rowCount, value);
+    column.inferType();
 }
 
 void Dataframe::merge(Dataframe &df, std::vector<std::string> &colNames,
 const std::string &suffixLeft, const std::string &suffixRight, const std::string &defaultValue) {
-    std::unordered_map<std::string, std::vector<int>> leftMap;
+    std::unordered_map<std::string, std::vector<size_t>> leftMap;
     std::unordered_map<std::string, std::string> rightMap;
     std::string key;
     bool mergeOk = false;
-    for (auto &row : rows) {
+    // Key columns that are categorical on both sides are matched by code, the
+    // right dictionary is translated to left codes once instead of per row
+    std::vector<const Column *> leftKeys;
+    std::vector<const Column *> rightKeys;
+    std::vector<std::vector<int32_t>> rightToLeft;
+    for (const std::string &col : colNames) {
+        int leftIndex = getColumnIndex(col);
+        int rightIndex = df.getColumnIndex(col);
+        leftKeys.push_back(leftIndex >= 0 ? &columns[leftIndex] : nullptr);
+        rightKeys.push_back(rightIndex >= 0 ? &df.columns[rightIndex] : nullptr);
+        std::vector<int32_t> remap;
+        if (leftIndex >= 0 && rightIndex >= 0 && leftKeys.back()->getType() == ColumnType::Categorical
+            && rightKeys.back()->getType() == ColumnType::Categorical) {
+            for (const auto &val : rightKeys.back()->dictionaryData()) {
+                remap.push_back(leftKeys.back()->findCode(val));
+            }
+        }
+        rightToLeft.push_back(remap);
+    }
+    for (size_t i = 0; i < rowCount; ++i) {
         key = "";
-        for (const std::string &col : colNames) {
-            key += row.getData(col);
+        for (size_t k = 0; k < leftKeys.size(); ++k) {
+            if (leftKeys[k] == nullptr) {
+                key += '\x1f';
+            }
+            else {
+                appendKeyPart(key, *leftKeys[k], i, !rightToLeft[k].empty());
+            }
         }
-        leftMap[key].push_back(getRowIndex(row));
+        leftMap[key].push_back(i);
     }
-    for (auto &row : df.getRows()) {
-        int rightIndex = df.getRowIndex(row);
+    for (size_t rightIndex = 0; rightIndex < df.getRowCount(); ++rightIndex) {
         key = "";
-        for (const std::string &col : colNames) {
-            key += row.getData(col);
-        }        
+        bool matchable = true;
+        for (size_t k = 0; k < rightKeys.size(); ++k) {
+            if (rightKeys[k] == nullptr) {
+                key += '\x1f';
+            }
+            else if (!rightToLeft[k].empty()) {
+                int32_t rightCode = rightKeys[k]->codeData()[rightIndex];
+                int32_t code = rightCode < 0 ? -1 : rightToLeft[k][rightCode];
+                matchable = matchable && (rightCode < 0 || code >= 0);
+                key.append(reinterpret_cast<const char *>(&code), sizeof(code));
+                key += '\x1f';
+            }
+            else {
+                appendKeyPart(key, *rightKeys[k], rightIndex, false);
+            }
+        }
+        if (!matchable) {
+            continue;
+        }
         auto it = leftMap.find(key);
         if (it != leftMap.end()) {
-            std::vector<int> &indices = it->second;
+            std::vector<size_t> &indices = it->second;
             if (!mergeOk){
                 mergeOk = true;
                 rightMap = prepareMerge(df.getHeaders(), colNames, suffixLeft, suffixRight, defaultValue);
             }
-            for (int &index : indices) {
-                for (auto &kv : rightMap) {
-                    const std::string originalCol = kv.first;
-                    const std::string rightCol = kv.second;
-                    std::string newValue = row.getData(originalCol);
-                    setValue(rightCol, index, newValue);
+            for (auto &kv : rightMap) {
+                const Column &source = df.getColumnData(kv.first);
+                Column &target = getColumnData(kv.second);
+                for (size_t index : indices) {
+                    target.set(index, source.get(rightIndex));
                 }
             }
         }
@@ -608,30 +920,75 @@ const std::string &suffixLeft, const std::string &suffixRight, const std::string
 
 std::vector<std::string> Dataframe::getColumn(const std::string &colName) {
     std::vector<std::string> col;
-    for (auto &row : rows) {
-        col.push_back(row.getData(colName));
+    int index = getColumnIndex(colName);
+    col.reserve(rowCount);
+    for (size_t i = 0; i < rowCount; ++i) {
+        col.push_back(index >= 0 ? columns[index].get(i) : "");
     }
     return col;
 }
 
-void Dataframe::saveToCSV(char sep, std::string filename, bool header) {    
+// Rows are formatted on the given number of threads, 0 uses every hardware thread
+void Dataframe::saveToCSV(char sep, std::string filename, bool header, unsigned threads) {
     std::ofstream file(filename);
     if (!file) {
         std::cerr << "Error: Cannot open file '" << filename << "' for writing." << std::endl;
         return;
     }
+    CSVWriter writer(file, sep, threads);
     if (header) {
-        for (size_t i = 0; i < headers.size(); ++i) {
-            if (i > 0) {
-                file << sep;
-            }
-            file << headers[i];
-        }
-        file << std::endl;
+        writer.writeHeader(headers);
     }
-    for (auto &row : rows) {
-        file << row.getRowStr(headers, sep);
-        file << std::endl;
+    writer.writeRows(columns, rowCount);
+    file.close();
+}
+
+void Dataframe::saveToJSONL(std::string filename, unsigned threads) {
+    std::ofstream file(filename);
+    if (!file) {
+        std::cerr << "Error: Cannot open file '" << filename << "' for writing." << std::endl;
+        return;
     }
+    JSONLWriter writer(file, headers, threads);
+    writer.writeRows(columns, rowCount);
     file.close();
 }
+
+// Loads newline-delimited JSON, typing the columns like readData does
+Dataframe Dataframe::readJSONL(const std::string &path, const std::vector<std::string> &categoricalColumns) {
+    Dataframe df;
+    JSONLReader reader(path, categoricalColumns);
+    reader.read(df.headers, df.columns);
+    df.rowCount = df.columns.empty() ? 0 : df.columns[0].size();
+    for (auto &column : df.columns) {
+        column.inferType();
+    }
+    return df;
+}
+
+// Saves the dataframe in the binary columnar format of DataFile
+void Dataframe::save(const std::string &path) {
+    if (!DataFile::save(path, headers, columns, rowCount)) {
+        std::cerr << "Error: Cannot open file '" << path << "' for writing." << std::endl;
+    }
+}
+
+// Loads a dataframe saved with save, mapping the file instead of parsing it
+Dataframe Dataframe::open(const std::string &path) {
+    Dataframe df;
+    DataFile::open(path, df.headers, df.columns, df.rowCount);
+    return df;
+}
+
+// Exports the columns as an Arrow struct array, the dataframe must outlive the
+// consumer's use of it and stay unchanged
+void Dataframe::exportArrow(ArrowArray *array, ArrowSchema *schema) {
+    ArrowData::exportColumns(headers, columns, rowCount, array, schema);
+}
+
+// Takes over an Arrow struct array, releasing the schema once it is read
+Dataframe Dataframe::importArrow(ArrowArray *array, ArrowSchema *schema) {
+    Dataframe df;
+    ArrowData::importColumns(array, schema, df.headers, df.columns, df.rowCount);
+    return df;
+}
@@ -16,36 +16,61 @@
 #include <type_traits>
 #include <cmath>
 #include "nlohmann/json.hpp"
-#include "rapidcsv.h"
 #include "CSVRow.hpp"
+#include "Column.hpp"
+#include "CSVReader.hpp"
+#include "FilterExpression.hpp"
+#include "Expression.hpp"
+#include "GroupBy.hpp"
+#include "CSVWriter.hpp"
+#include "JSONLReader.hpp"
+#include "JSONLWriter.hpp"
+#include "DataFile.hpp"
+#include "ArrowData.hpp"
 #include "utils.hpp"
 
 using json = nlohmann::json;
 
 class Dataframe {
+    friend class CSVBatchReader;
+    friend class DataframeView;
+    friend class SortedGroupBy;
+
 private:
-    rapidcsv::Document doc;
     std::vector<std::string> headers;
-    std::vector<CSVRow> rows;
+    std::vector<Column> columns;
+    size_t rowCount;
     bool isReplacingNulls;
     std::string nullReplacement;
     void printHeaders(const std::vector<std::string> &headers);
+    void readData(const std::string &path, const CSVOptions &options);
+    void addColumn(const std::string &colName, Column &&column);
+    void selectRows(const std::vector<size_t> &indices);
+    void evaluateFilter(const Predicate &predicate, std::vector<uint64_t> &mask);
+    void compactRows(const std::vector<uint64_t> &mask);
 
 public:
     Dataframe();
-    Dataframe(const std::string path, char sep = ',', int rowSkip = 0);
+    Dataframe(const std::string path, char sep = ',', int rowSkip = 0,
+        const std::vector<std::string> &categoricalColumns = {});
+    Dataframe(const std::string path, const CSVOptions &options);
     Dataframe(const Dataframe &other);
-    Dataframe(std::vector<std::vector<std::string>> &dfData);
+    Dataframe(std::vector<std::vector<std::string>> &dfData, bool replaceNulls = false,
+        const std::string &nullReplacement = "0");
     std::vector<std::string> getHeaders();
     std::vector<CSVRow> getRows();
+    size_t getRowCount() const;
+    Column &getColumnData(const std::string &colName);
     int getRowIndex(CSVRow &row);
-    void readData();
-    void renameColumns(const std::vector<std::pair<std::string, std::string>> &columns, bool renameCSVRowMaps = true);
+    void setColumnType(const std::string &colName, ColumnType type);
+    void renameColumns(const std::vector<std::pair<std::string, std::string>> &columns);
     void printDataframe();
     int getColumnIndex(std::string colName);
     void setReplaceNull(bool rep);
     void setNullReplacement(std::string rep);
     void replaceNull(std::string replace, const std::vector<std::string> &colNames);
+    bool isNull(const std::string &colName, int row);
+    size_t nullCount(const std::string &colName);
     // void dropDuplicates(); // FIXME
     void dropColumns(const std::vector<std::string> &columns);
     void renameHeader(const std::vector<std::string> &columns);
@@ -62,6 +87,7 @@ public:
     void createNewColumn(const std::string &colName, std::string &defaultValue);
     void createNewColumn(const std::string &colName, std::vector<std::string> &sumColumns);
     void createNewColumn(const std::string &colName, std::string &col1, std::string &col2);
+    void createNewColumn(const std::string &colName, const Expression &expression);
     // void createNewColumnDiv(const std::string &colName, const std::string &col1, const std::string &col2);
     // void createNewColumnMult(const std::string &colName, const std::string &col1, const std::string &col2);
     void setColumnValue(const std::string &colName, const std::string &value);
@@ -69,18 +95,31 @@ public:
     bool operationResult(CSVRow &row, const std::string &col, const std::string &op, std::string &value);
     bool operationResult(CSVRow &row, const std::string &col, const std::string &op, double value);
     template<typename T> void filterRows(const std::string &colName, const std::string &op, T value);
+    void filter(const FilterExpression &expression);
     void merge(Dataframe &df, std::vector<std::string> &colNames,
         const std::string &suffixLeft, const std::string &suffixRight, const std::string &defaultValue);
     void groupBy(const std::vector<std::string> &colNames);
+    void groupBy(const std::vector<std::string> &colNames, const std::vector<Aggregation> &aggregations,
+        unsigned threads = 1);
     std::vector<std::string> unique(const std::string &col);
-    std::string sum(const std::string &col);
+    double sum(const std::string &col, bool compensated = false);
+    double mean(const std::string &col, bool compensated = false);
+    double var(const std::string &col);
+    double min(const std::string &col);
+    double max(const std::string &col);
+    size_t count(const std::string &col);
     void sliceValues(const std::string &col, int start, int end);
     void roundDouble(const std::string &col, int precision);
     void sortBy(const std::string &colName, bool ascending = true);
     void concatCol(Dataframe &df);
     void concatRow(Dataframe &df);
-    std::string max(const std::string &col);
-    void saveToCSV(char sep, std::string filename, bool header = true);
+    void saveToCSV(char sep, std::string filename, bool header = true, unsigned threads = 1);
+    void saveToJSONL(std::string filename, unsigned threads = 1);
+    static Dataframe readJSONL(const std::string &path, const std::vector<std::string> &categoricalColumns = {});
+    void save(const std::string &path);
+    static Dataframe open(const std::string &path);
+    void exportArrow(ArrowArray *array, ArrowSchema *schema);
+    static Dataframe importArrow(ArrowArray *array, ArrowSchema *schema);
 };
 
 #endif  // DATAFRAME_HPP
@@ -1,4 +1,15 @@
 #include "utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#endif
 
 std::vector<std::string> splitStr(const std::string& s, char delimiter) {
     std::vector<std::string> tokens;
@@ -7,4 +18,215 @@ std::vector<std::string> splitStr(const std::string& s, char delimiter) {
     while (getline(token_stream, token, delimiter))
         tokens.push_back(token);
     return tokens;
-}
\ No newline at end of file
+}
+
+// Numbers are read and written with from_chars/to_chars: locale independent,
+// no terminated copy and no exceptions. The policy for all numeric parsing:
+// surrounding spaces and tabs and a leading '+' are accepted, the rest of the
+// text must be consumed, hex is rejected and out of range values fail.
+// nan and inf spellings parse to the IEEE values.
+static std::string_view trimNumber(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+        s.remove_suffix(1);
+    }
+    if (s.size() > 1 && s.front() == '+' && s[1] != '-' && s[1] != '+') {
+        s.remove_prefix(1);
+    }
+    return s;
+}
+
+bool parseInt64(std::string_view s, int64_t &out) {
+    s = trimNumber(s);
+    if (s.empty()) {
+        return false;
+    }
+    int64_t value;
+    auto result = std::from_chars(s.data(), s.data() + s.size(), value);
+    if (result.ec != std::errc() || result.ptr != s.data() + s.size()) {
+        return false;
+    }
+    out = value;
+    return true;
+}
+
+bool parseDouble(std::string_view s, double &out) {
+    s = trimNumber(s);
+    if (s.empty()) {
+        return false;
+    }
+    double value;
+    auto result = std::from_chars(s.data(), s.data() + s.size(), value);
+    if (result.ec != std::errc() || result.ptr != s.data() + s.size()) {
+        return false;
+    }
+    out = value;
+    return true;
+}
+
+// Throwing variant for the arithmetic helpers, empty text reads as zero
+double toDouble(std::string_view s) {
+    double value = 0;
+    if (!s.empty() && !parseDouble(s, value)) {
+        throw std::invalid_argument("not a number: " + std::string(s));
+    }
+    return value;
+}
+
+bool parseBool(std::string_view s, bool &out) {
+    if (s == "true" || s == "True" || s == "TRUE") {
+        out = true;
+        return true;
+    }
+    if (s == "false" || s == "False" || s == "FALSE") {
+        out = false;
+        return true;
+    }
+    return false;
+}
+
+// Writes value into [first, last) and returns the end of the text, or nullptr
+// when it does not fit. A negative precision gives the shortest text that reads
+// back to the same value, in fixed notation unless the exponent is below -4 or
+// reaches the number of significant digits (at least 15), as %g would print it
+char *writeDouble(char *first, char *last, double value, int precision) {
+    if (std::isnan(value)) {
+        if (last - first < 3) {
+            return nullptr;
+        }
+        std::memcpy(first, "NaN", 3);
+        return first + 3;
+    }
+    if (precision >= 0) {
+        auto result = std::to_chars(first, last, value, std::chars_format::fixed, precision);
+        return result.ec == std::errc() ? result.ptr : nullptr;
+    }
+    auto result = std::to_chars(first, last, value, std::chars_format::scientific);
+    if (result.ec != std::errc()) {
+        return nullptr;
+    }
+    const char *exponent = std::find(static_cast<const char *>(first), static_cast<const char *>(result.ptr), 'e');
+    if (exponent == result.ptr) {
+        return result.ptr;
+    }
+    int digits = 0;
+    for (const char *p = first; p < exponent; ++p) {
+        digits += *p >= '0' && *p <= '9';
+    }
+    const char *powerStart = exponent[1] == '+' ? exponent + 2 : exponent + 1;
+    int power = 0;
+    std::from_chars(powerStart, result.ptr, power);
+    if (power < -4 || power >= std::max(digits, 15)) {
+        return result.ptr;
+    }
+    result = std::to_chars(first, last, value, std::chars_format::fixed);
+    return result.ec == std::errc() ? result.ptr : nullptr;
+}
+
+std::string formatDouble(double value, int precision) {
+    char buffer[128];
+    char *end = writeDouble(buffer, buffer + sizeof(buffer), value, precision);
+    if (end != nullptr) {
+        return std::string(buffer, end);
+    }
+    // Only fixed notation with many decimals needs more room
+    std::string large(static_cast<size_t>(precision) + 400, '\0');
+    end = writeDouble(&large[0], &large[0] + large.size(), value, precision);
+    large.resize(end - large.data());
+    return large;
+}
+
+// Runtime check used to pick the AVX2 kernels, the result is computed once
+bool cpuHasAVX2() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    return hasAVX2;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    static const bool hasAVX2 = [] {
+        int info[4];
+        __cpuid(info, 1);
+        bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return osSavesYmm && (info[1] & (1 << 5)) != 0;
+    }();
+    return hasAVX2;
+#else
+    return false;
+#endif
+}
+
+// Resolves a requested worker count, 0 means one per hardware thread
+unsigned threadCount(unsigned requested) {
+    if (requested > 0) {
+        return requested;
+    }
+    unsigned hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+// Runs body(i) for every i in [0, count) on up to threads workers, the
+// calling thread included. Items are handed out one at a time.
+void parallelFor(size_t count, unsigned threads, const std::function<void(size_t)> &body) {
+    size_t workers = std::min<size_t>(threads, count);
+    if (workers <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            body(i);
+        }
+        return;
+    }
+    std::atomic<size_t> nextItem(0);
+    auto work = [&]() {
+        for (size_t i = nextItem++; i < count; i = nextItem++) {
+            body(i);
+        }
+    };
+    std::vector<std::thread> pool;
+    pool.reserve(workers - 1);
+    for (size_t w = 1; w < workers; ++w) {
+        pool.emplace_back(work);
+    }
+    work();
+    for (auto &thread : pool) {
+        thread.join();
+    }
+}
+
+// Rows formatted per block, and the buffered text that triggers a write
+static const size_t ROWS_PER_BLOCK = 16384;
+static const size_t FLUSH_BYTES = 1 << 20;
+
+// Writes rows [0, rowCount) to out in order, format(buffer, begin, end)
+// appending the text of rows [begin, end) to buffer. Blocks of rows share
+// large reused buffers; with more than one thread each round formats one
+// block per thread in parallel, then writes them in row order.
+void writeBlocks(std::ostream &out, size_t rowCount, unsigned threads,
+    const std::function<void(std::string &, size_t, size_t)> &format) {
+    const size_t blockCount = (rowCount + ROWS_PER_BLOCK - 1) / ROWS_PER_BLOCK;
+    if (threads <= 1 || blockCount <= 1) {
+        std::string buffer;
+        buffer.reserve(FLUSH_BYTES + FLUSH_BYTES / 4);
+        for (size_t begin = 0; begin < rowCount; begin += ROWS_PER_BLOCK) {
+            format(buffer, begin, std::min(begin + ROWS_PER_BLOCK, rowCount));
+            if (buffer.size() >= FLUSH_BYTES) {
+                out.write(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+        }
+        out.write(buffer.data(), buffer.size());
+        return;
+    }
+    std::vector<std::string> buffers(std::min<size_t>(threads, blockCount));
+    for (size_t first = 0; first < blockCount; first += buffers.size()) {
+        size_t roundBlocks = std::min(buffers.size(), blockCount - first);
+        parallelFor(roundBlocks, static_cast<unsigned>(roundBlocks), [&](size_t i) {
+            size_t begin = (first + i) * ROWS_PER_BLOCK;
+            buffers[i].clear();
+            format(buffers[i], begin, std::min(begin + ROWS_PER_BLOCK, rowCount));
+        });
+        for (size_t i = 0; i < roundBlocks; ++i) {
+            out.write(buffers[i].data(), buffers[i].size());
+        }
+    }
+}
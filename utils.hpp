@@ -4,10 +4,45 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <fstream>
 #include <iomanip>
+#include <cstdint>
+#include <functional>
 
 std::vector<std::string> splitStr(const std::string& s, char delimiter);
+bool parseInt64(std::string_view s, int64_t &out);
+bool parseDouble(std::string_view s, double &out);
+bool parseBool(std::string_view s, bool &out);
+double toDouble(std::string_view s);
+char *writeDouble(char *first, char *last, double value, int precision = -1);
+std::string formatDouble(double value, int precision = -1);
+
+bool cpuHasAVX2();
+unsigned threadCount(unsigned requested);
+void parallelFor(size_t count, unsigned threads, const std::function<void(size_t)> &body);
+void writeBlocks(std::ostream &out, size_t rowCount, unsigned threads,
+    const std::function<void(std::string &, size_t, size_t)> &format);
+
+// Bit helpers for the 64-bit words of validity bitmaps
+inline int popCount(uint64_t w) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(w);
+#else
+    w = w - ((w >> 1) & 0x5555555555555555ULL);
+    w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+    w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return static_cast<int>((w * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+inline int lowestBit(uint64_t w) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(w);
+#else
+    return popCount((w & (0 - w)) - 1);
+#endif
+}
 
 #endif  // UTILS_HPP